@@ -0,0 +1,341 @@
+#include "AsyncSERPClient.h"
+#include "Network/Network.h"
+#include "Utility/Formatting.h"
+
+#include <algorithm>
+#include <iostream>
+#ifdef _LINUX
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#endif // _LINUX
+#ifdef _WINDOWS
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#endif // _WINDOWS
+
+void SERPEventLoop::fireTimers()
+{
+	auto currentTime = std::chrono::steady_clock::now();
+	while (!timerQueue.empty() && timerQueue.top().first <= currentTime) {
+		uint64_t timerID = timerQueue.top().second;
+		timerQueue.pop();
+		auto timer = timers.find(timerID);
+		if (timer == timers.end()) continue;
+		// Move the callback out first, it may add or cancel timers
+		std::function<void()> callback = std::move(timer->second);
+		timers.erase(timer);
+		callback();
+	}
+}
+
+int SERPEventLoop::getPollTimeout() const
+{
+	// After stop() was called, the current iteration must not block
+	if (!running || !readyCoroutines.empty()) return 0;
+	if (timerQueue.empty()) return -1;
+	auto remaining = std::chrono::ceil<std::chrono::milliseconds>(timerQueue.top().first - std::chrono::steady_clock::now());
+	return static_cast<int>(std::clamp<int64_t>(remaining.count(), 0, 60000));
+}
+
+void SERPEventLoop::releaseFinishedTasks()
+{
+	for (auto it = spawnedTasks.begin(); it != spawnedTasks.end();) {
+		if (!it->isDone()) {
+			++it;
+			continue;
+		}
+		std::exception_ptr exception = it->getException();
+		it = spawnedTasks.erase(it);
+		if (!exception) continue;
+		if (errorHandler) {
+			errorHandler(exception);
+			continue;
+		}
+		try {
+			std::rethrow_exception(exception);
+		}
+		catch (const std::exception& e) {
+			std::cout << "[ERROR]: A spawned task failed: " << e.what() << std::endl;
+		}
+		catch (...) {
+			std::cout << "[ERROR]: A spawned task failed with an unknown exception." << std::endl;
+		}
+	}
+}
+
+void SERPEventLoop::spawn(Task<void> task)
+{
+	// The list keeps the task alive while it runs, a spawned task has nobody that awaits it
+	spawnedTasks.push_back(std::move(task));
+	spawnedTasks.back().start();
+}
+
+void SERPEventLoop::schedule(std::coroutine_handle<> coroutine)
+{
+	readyCoroutines.push_back(coroutine);
+}
+
+void SERPEventLoop::unschedule(std::coroutine_handle<> coroutine)
+{
+	std::erase(readyCoroutines, coroutine);
+	// A coroutine resumed in this iteration may destroy one that comes later in the same iteration
+	std::ranges::replace(resumingCoroutines, coroutine, std::coroutine_handle<>());
+}
+
+uint64_t SERPEventLoop::addTimer(std::chrono::steady_clock::duration delay, std::function<void()> callback)
+{
+	uint64_t timerID = nextTimerID++;
+	timers.emplace(timerID, std::move(callback));
+	timerQueue.emplace(std::chrono::steady_clock::now() + delay, timerID);
+	return timerID;
+}
+
+void SERPEventLoop::cancelTimer(uint64_t timerID)
+{
+	timers.erase(timerID);
+}
+
+void SERPEventLoop::run()
+{
+	running = true;
+	std::vector<pollfd> fileDescriptors;
+	std::vector<AsyncSERPConnection*> polledConnections;
+	auto isServingRequests = [](const AsyncSERPConnection* connection) { return connection->connected && connection->requestHandler; };
+	while (running && (!spawnedTasks.empty() || !readyCoroutines.empty() || !timers.empty() || std::ranges::any_of(connections, isServingRequests))) {
+		// Resume everything that became ready. Coroutines scheduled meanwhile wait for the next iteration,
+		// st. sockets and timers are not starved.
+		std::swap(resumingCoroutines, readyCoroutines);
+		while (!resumingCoroutines.empty()) {
+			std::coroutine_handle<> coroutine = resumingCoroutines.front();
+			resumingCoroutines.pop_front();
+			if (coroutine) coroutine.resume();
+		}
+		releaseFinishedTasks();
+		// Wait for socket events or the next timer
+		fileDescriptors.clear();
+		polledConnections.clear();
+		for (AsyncSERPConnection* connection : connections) {
+			if (!connection->connected) continue;
+			short events = POLLIN;
+			if (connection->endpoint.hasUnsentMessages()) events |= POLLOUT;
+			fileDescriptors.push_back(pollfd{ connection->endpoint.getTCPEndpoint().getSocket().sock, events, 0 });
+			polledConnections.push_back(connection);
+		}
+		int timeout = getPollTimeout();
+		if (!fileDescriptors.empty()) {
+#ifdef _WINDOWS
+			int result = WSAPoll(fileDescriptors.data(), static_cast<ULONG>(fileDescriptors.size()), timeout);
+#endif // _WINDOWS
+#ifdef _LINUX
+			int result = poll(fileDescriptors.data(), fileDescriptors.size(), timeout);
+#endif // _LINUX
+			if (result > 0) {
+				for (std::size_t i = 0; i < fileDescriptors.size(); ++i) {
+					// The connection may have been closed by a previous callback
+					if (!polledConnections[i]->connected || fileDescriptors[i].revents == 0) continue;
+					if (fileDescriptors[i].revents & POLLOUT) polledConnections[i]->onWritable();
+					if (fileDescriptors[i].revents & (POLLIN | POLLHUP | POLLERR)) polledConnections[i]->onReadable();
+				}
+			}
+		}
+		else if (timeout != 0 && !timers.empty()) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(timeout));
+		}
+		else if (timeout != 0 && readyCoroutines.empty()) {
+			// Tasks are waiting, but nothing can ever wake them up. Destroying them unregisters their awaiters.
+			spawnedTasks.clear();
+			break;
+		}
+		fireTimers();
+		releaseFinishedTasks();
+	}
+}
+
+SERPEventLoop::~SERPEventLoop()
+{
+	// The awaiters of the destroyed tasks still use the timers and the queues of ready coroutines
+	spawnedTasks.clear();
+}
+
+void SERPEventLoop::SleepAwaiter::await_suspend(std::coroutine_handle<> coroutine)
+{
+	this->coroutine = coroutine;
+	timerID = loop.addTimer(duration, [this]() {
+		timerID = 0;
+		scheduled = true;
+		loop.schedule(this->coroutine);
+	});
+}
+
+SERPEventLoop::SleepAwaiter::~SleepAwaiter()
+{
+	if (timerID != 0) loop.cancelTimer(timerID);
+	if (scheduled) loop.unschedule(coroutine);
+}
+
+void AsyncSERPConnection::RequestAwaiter::await_suspend(std::coroutine_handle<> coroutine)
+{
+	this->coroutine = coroutine;
+	if (!connection.sendRequest(*this)) {
+		scheduled = true;
+		loop.schedule(coroutine);
+	}
+}
+
+AsyncSERPConnection::RequestAwaiter::~RequestAwaiter()
+{
+	// A pending request keeps its place, st. its response is not taken for the response of a later request
+	if (pending) connection.completeRequest(*this, nullptr);
+	// The connection may be gone already, the loop has to outlive it anyway
+	if (scheduled) loop.unschedule(coroutine);
+}
+
+AsyncSERPConnection::AsyncSERPConnection(SERPEventLoop& loop, SnackerEngine::SocketTCP socket)
+	: loop{ loop }, endpoint(std::move(socket)), serpID{}, pendingRequests{}, requestHandler{}
+{
+	loop.connections.push_back(this);
+}
+
+bool AsyncSERPConnection::sendRequest(RequestAwaiter& awaiter)
+{
+	SnackerEngine::SERPRequest& request = *awaiter.request;
+	request.getHeader().source = serpID;
+	if (!endpoint.finalizeAndSendMessage(request, false)) {
+		close();
+		return false;
+	}
+	pendingRequests[request.getHeader().destination].push_back(&awaiter);
+	numberOfPendingRequests++;
+	awaiter.pending = true;
+	RequestAwaiter* awaiterPointer = &awaiter;
+	awaiter.timerID = loop.addTimer(awaiter.timeout, [this, awaiterPointer]() {
+		awaiterPointer->timerID = 0;
+		completeRequest(*awaiterPointer, nullptr);
+		awaiterPointer->scheduled = true;
+		loop.schedule(awaiterPointer->coroutine);
+	});
+	return true;
+}
+
+void AsyncSERPConnection::completeRequest(RequestAwaiter& awaiter, std::unique_ptr<SnackerEngine::SERPResponse> response)
+{
+	if (!awaiter.pending) return;
+	awaiter.pending = false;
+	numberOfPendingRequests--;
+	auto queue = pendingRequests.find(awaiter.request->getHeader().destination);
+	if (queue != pendingRequests.end()) std::ranges::replace(queue->second, &awaiter, static_cast<RequestAwaiter*>(nullptr));
+	if (awaiter.timerID != 0) loop.cancelTimer(awaiter.timerID);
+	awaiter.timerID = 0;
+	awaiter.response = std::move(response);
+}
+
+void AsyncSERPConnection::handleResponse(std::unique_ptr<SnackerEngine::SERPResponse> response)
+{
+	auto queue = pendingRequests.find(response->getHeader().source);
+	// Responses to requests we did not send are dropped
+	if (queue == pendingRequests.end() || queue->second.empty()) return;
+	RequestAwaiter* awaiter = queue->second.front();
+	queue->second.pop_front();
+	if (queue->second.empty()) pendingRequests.erase(queue);
+	// Late responses to requests that already timed out are dropped
+	if (!awaiter) return;
+	completeRequest(*awaiter, std::move(response));
+	awaiter->scheduled = true;
+	loop.schedule(awaiter->coroutine);
+}
+
+void AsyncSERPConnection::onReadable()
+{
+	auto messages = endpoint.receiveMessages();
+	if (!messages.has_value()) {
+		close();
+		return;
+	}
+	for (auto& message : messages.value()) {
+		if (!message->isRequest()) {
+			handleResponse(std::unique_ptr<SnackerEngine::SERPResponse>(static_cast<SnackerEngine::SERPResponse*>(message.release())));
+			continue;
+		}
+		std::unique_ptr<SnackerEngine::SERPRequest> request(static_cast<SnackerEngine::SERPRequest*>(message.release()));
+		if (requestHandler) loop.spawn(requestHandler(*this, std::move(request)));
+		else respond(*request, SnackerEngine::ResponseStatusCode::NOT_FOUND);
+	}
+}
+
+void AsyncSERPConnection::onWritable()
+{
+	if (!endpoint.updateSend()) close();
+}
+
+std::unique_ptr<AsyncSERPConnection> AsyncSERPConnection::connect(SERPEventLoop& loop, const std::string& address, uint16_t port)
+{
+	SnackerEngine::SocketTCP socketTCP;
+#ifdef _WINDOWS
+	socketTCP.sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (socketTCP.sock == INVALID_SOCKET) return nullptr;
+#endif // _WINDOWS
+#ifdef _LINUX
+	socketTCP.sock = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (socketTCP.sock == -1) return nullptr;
+#endif // _LINUX
+	sockaddr_in serverAddress{};
+	serverAddress.sin_family = AF_INET;
+	serverAddress.sin_port = htons(port);
+	if (inet_pton(AF_INET, address.c_str(), &serverAddress.sin_addr) != 1) return nullptr;
+	// The connect itself blocks, everything afterwards is driven by the event loop
+	if (::connect(socketTCP.sock, reinterpret_cast<sockaddr*>(&serverAddress), sizeof(serverAddress)) != 0) return nullptr;
+	if (!SnackerEngine::setToNonBlocking(socketTCP)) return nullptr;
+	return std::unique_ptr<AsyncSERPConnection>(new AsyncSERPConnection(loop, std::move(socketTCP)));
+}
+
+Task<bool> AsyncSERPConnection::start()
+{
+	auto response = co_await request(SnackerEngine::SERPID::SERVER_ID, SnackerEngine::RequestStatusCode::GET, "serpID");
+	if (!response || response->getResponseStatusCode() != SnackerEngine::ResponseStatusCode::OK) co_return false;
+	std::string content(reinterpret_cast<const char*>(response->content.data()), response->content.size());
+	auto result = SnackerEngine::from_string<SnackerEngine::SERPID>(content);
+	if (!result.has_value()) co_return false;
+	serpID = result.value();
+	co_return true;
+}
+
+AsyncSERPConnection::RequestAwaiter AsyncSERPConnection::request(SnackerEngine::SERPID destination, SnackerEngine::RequestStatusCode requestStatusCode, const std::string& target, SnackerEngine::Buffer body, std::chrono::milliseconds timeout)
+{
+	auto request = std::make_unique<SnackerEngine::SERPRequest>(requestStatusCode, target, body);
+	request->getHeader().destination = destination;
+	return RequestAwaiter(*this, std::move(request), timeout);
+}
+
+bool AsyncSERPConnection::respond(const SnackerEngine::SERPRequest& request, SnackerEngine::ResponseStatusCode responseStatusCode, const SnackerEngine::Buffer& body)
+{
+	if (!connected) return false;
+	SnackerEngine::SERPResponse response(request, responseStatusCode, body);
+	if (!endpoint.finalizeAndSendMessage(response, false)) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void AsyncSERPConnection::close()
+{
+	if (!connected) return;
+	connected = false;
+	// Resume all pending requests with nullptr. They are resumed by the loop, not from in here.
+	for (auto& [destination, queue] : pendingRequests) {
+		for (RequestAwaiter* awaiter : queue) {
+			if (!awaiter) continue;
+			completeRequest(*awaiter, nullptr);
+			awaiter->scheduled = true;
+			loop.schedule(awaiter->coroutine);
+		}
+	}
+	pendingRequests.clear();
+}
+
+AsyncSERPConnection::~AsyncSERPConnection()
+{
+	close();
+	std::erase(loop.connections, this);
+}
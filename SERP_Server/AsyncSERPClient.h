@@ -0,0 +1,289 @@
+#pragma once
+#include "Network/SERP/SERPEndpoint.h"
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <functional>
+#include <unordered_map>
+#include <map>
+#include <list>
+#include <queue>
+#include <deque>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+
+/// Coroutine client library for SERP. A single threaded SERPEventLoop drives any number of
+/// AsyncSERPConnections, and each connection can have any number of requests in flight:
+///
+///		Task<void> session(AsyncSERPConnection& connection) {
+///			auto response = co_await connection.request(destination, SnackerEngine::RequestStatusCode::GET, "chat/messages");
+///			if (!response) co_return; // timed out or disconnected
+///			...
+///		}
+///		loop.spawn(session(*connection));
+///		loop.run();
+///
+/// Suspended coroutines cost only their frame, st. a single process can run thousands of sessions.
+///
+/// SERP messages carry no request ID, so responses are matched to requests in the order the requests were
+/// sent to the same destination. This works with the server (it answers the requests of a client in order)
+/// and with clients that answer in order. A request that timed out keeps its place until its response
+/// arrives or the server reports the timeout, its late response is dropped.
+
+template<typename T>
+class Task;
+
+/// Promise parts shared by all tasks
+struct TaskPromiseBase
+{
+	/// Coroutine that awaits this task and is resumed when it finishes
+	std::coroutine_handle<> continuation;
+	std::exception_ptr exception;
+	/// Tasks are started when they are awaited
+	std::suspend_always initial_suspend() noexcept { return {}; }
+	/// Resumes the awaiting coroutine when the task finishes
+	struct FinalAwaiter
+	{
+		bool await_ready() noexcept { return false; }
+		template<typename Promise>
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+		{
+			std::coroutine_handle<> continuation = handle.promise().continuation;
+			return continuation ? continuation : std::noop_coroutine();
+		}
+		void await_resume() noexcept {}
+	};
+	FinalAwaiter final_suspend() noexcept { return {}; }
+	void unhandled_exception() { exception = std::current_exception(); }
+};
+
+template<typename T>
+struct TaskPromise : TaskPromiseBase
+{
+	std::optional<T> value;
+	Task<T> get_return_object();
+	void return_value(T result) { value = std::move(result); }
+};
+
+template<>
+struct TaskPromise<void> : TaskPromiseBase
+{
+	Task<void> get_return_object();
+	void return_void() {}
+};
+
+/// A lazily started coroutine that returns a T. Is awaited with co_await or started with SERPEventLoop::spawn().
+template<typename T = void>
+class Task
+{
+public:
+	using promise_type = TaskPromise<T>;
+private:
+	std::coroutine_handle<promise_type> handle;
+public:
+	explicit Task(std::coroutine_handle<promise_type> handle) : handle{ handle } {}
+	Task(Task&& other) noexcept : handle{ std::exchange(other.handle, nullptr) } {}
+	Task& operator=(Task&& other) noexcept
+	{
+		if (this != &other) {
+			if (handle) handle.destroy();
+			handle = std::exchange(other.handle, nullptr);
+		}
+		return *this;
+	}
+	/// Destroying a task that is suspended destroys its frame, awaiters in it unregister themselves
+	~Task() { if (handle) handle.destroy(); }
+	Task(const Task& other) = delete;
+	Task& operator=(const Task& other) = delete;
+	/// Starts a task that is not awaited by another coroutine (used by SERPEventLoop::spawn())
+	void start() { handle.resume(); }
+	/// Returns true if the task finished, and true if it finished with an exception
+	bool isDone() const { return !handle || handle.done(); }
+	bool hasFailed() const { return handle && handle.done() && handle.promise().exception; }
+	/// Returns the exception the task finished with, or nullptr
+	std::exception_ptr getException() const { return hasFailed() ? handle.promise().exception : nullptr; }
+	/// Awaiting a task starts it and resumes the awaiting coroutine once it finished
+	bool await_ready() const noexcept { return !handle || handle.done(); }
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+	{
+		handle.promise().continuation = awaiting;
+		return handle;
+	}
+	T await_resume()
+	{
+		if (handle.promise().exception) std::rethrow_exception(handle.promise().exception);
+		if constexpr (!std::is_void_v<T>) return std::move(*handle.promise().value);
+	}
+};
+
+template<typename T>
+Task<T> TaskPromise<T>::get_return_object() { return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this)); }
+inline Task<void> TaskPromise<void>::get_return_object() { return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this)); }
+
+class AsyncSERPConnection;
+
+/// Single threaded event loop. Waits for socket events of all connections and for timers, and resumes
+/// the coroutines that waited for them. None of the classes of this library are thread safe, everything
+/// has to happen on the thread that calls run().
+class SERPEventLoop
+{
+	friend class AsyncSERPConnection;
+	/// Coroutines that can continue, and the coroutines that are resumed in the current iteration. Destroyed
+	/// coroutines are removed from both (see unschedule()).
+	std::deque<std::coroutine_handle<>> readyCoroutines;
+	std::deque<std::coroutine_handle<>> resumingCoroutines;
+	/// Timers by ID and a queue of (deadline, ID) ordered by deadline. Cancelled timers are removed from
+	/// the map only, their queue entry is skipped once it comes up.
+	std::unordered_map<uint64_t, std::function<void()>> timers;
+	std::priority_queue<std::pair<std::chrono::steady_clock::time_point, uint64_t>, std::vector<std::pair<std::chrono::steady_clock::time_point, uint64_t>>, std::greater<>> timerQueue;
+	uint64_t nextTimerID = 1;
+	/// Registered connections
+	std::vector<AsyncSERPConnection*> connections;
+	/// Spawned tasks that have not finished yet
+	std::list<Task<void>> spawnedTasks;
+	/// true until stop() is called
+	bool running = true;
+	/// Called with the exceptions escaping spawned tasks. If empty, they are logged.
+	std::function<void(std::exception_ptr)> errorHandler;
+	/// Runs all timers whose deadline has passed
+	void fireTimers();
+	/// Returns the poll timeout in ms until the next timer is due (-1 if there is none)
+	int getPollTimeout() const;
+	/// Releases spawned tasks that finished and passes the exceptions of failed ones to the error handler
+	void releaseFinishedTasks();
+public:
+	SERPEventLoop() = default;
+	/// Starts the given task. It runs until its first suspension right away. Exceptions escaping a
+	/// spawned task go to the error handler, the task is dropped.
+	void spawn(Task<void> task);
+	/// Sets the handler for exceptions escaping spawned tasks. It runs on the loop, after the task
+	/// finished. By default, the exceptions are logged.
+	void setErrorHandler(std::function<void(std::exception_ptr)> errorHandler) { this->errorHandler = std::move(errorHandler); }
+	/// Resumes the given coroutine in the next iteration of the loop
+	void schedule(std::coroutine_handle<> coroutine);
+	/// Removes a scheduled coroutine that is about to be destroyed
+	void unschedule(std::coroutine_handle<> coroutine);
+	/// Calls callback once the given time has passed. Returns an ID for cancelTimer().
+	uint64_t addTimer(std::chrono::steady_clock::duration delay, std::function<void()> callback);
+	void cancelTimer(uint64_t timerID);
+	/// Awaitable that resumes the awaiting coroutine after the given time. Cancels its timer if the
+	/// awaiting coroutine is destroyed before.
+	class SleepAwaiter
+	{
+		SERPEventLoop& loop;
+		std::chrono::steady_clock::duration duration;
+		std::coroutine_handle<> coroutine;
+		uint64_t timerID = 0;
+		bool scheduled = false;
+	public:
+		SleepAwaiter(SERPEventLoop& loop, std::chrono::steady_clock::duration duration) : loop{ loop }, duration{ duration } {}
+		bool await_ready() const noexcept { return duration <= std::chrono::steady_clock::duration::zero(); }
+		void await_suspend(std::coroutine_handle<> coroutine);
+		void await_resume() noexcept { timerID = 0; scheduled = false; }
+		~SleepAwaiter();
+		SleepAwaiter(const SleepAwaiter& other) = delete;
+		SleepAwaiter& operator=(const SleepAwaiter& other) = delete;
+	};
+	SleepAwaiter sleep(std::chrono::steady_clock::duration duration) { return SleepAwaiter(*this, duration); }
+	/// Runs the loop until stop() is called or there is nothing left to wait for: no spawned tasks, timers
+	/// and connections with a request handler. Spawned tasks that wait for something that can never happen
+	/// (there is no connection, timer or ready coroutine left to wake them up) are destroyed.
+	void run();
+	/// Makes run() return after the current iteration. Spawned tasks stay suspended, run() continues them.
+	void stop() { running = false; }
+	/// Returns the number of spawned tasks that are still running
+	std::size_t getNumberOfRunningTasks() const { return spawnedTasks.size(); }
+	/// Destructor, destroys the spawned tasks that did not finish. Connections have to be destroyed first.
+	~SERPEventLoop();
+	/// Deleted Copy and move constructors and assignment operators
+	SERPEventLoop(SERPEventLoop& other) = delete;
+	SERPEventLoop(SERPEventLoop&& other) = delete;
+	SERPEventLoop& operator=(SERPEventLoop& other) = delete;
+	SERPEventLoop& operator=(SERPEventLoop&& other) = delete;
+};
+
+/// A connection to the SERP server that is driven by a SERPEventLoop
+class AsyncSERPConnection
+{
+	friend class SERPEventLoop;
+public:
+	/// Awaitable returned by request(). Results in the response, or nullptr if the request timed out or
+	/// the connection was closed. Unregisters itself if the awaiting coroutine is destroyed before.
+	class RequestAwaiter
+	{
+		friend class AsyncSERPConnection;
+		AsyncSERPConnection& connection;
+		SERPEventLoop& loop;
+		std::unique_ptr<SnackerEngine::SERPRequest> request;
+		std::chrono::milliseconds timeout;
+		std::unique_ptr<SnackerEngine::SERPResponse> response;
+		std::coroutine_handle<> coroutine;
+		uint64_t timerID = 0;
+		/// true while the request waits for its response, and true while the coroutine waits to be resumed
+		bool pending = false;
+		bool scheduled = false;
+	public:
+		RequestAwaiter(AsyncSERPConnection& connection, std::unique_ptr<SnackerEngine::SERPRequest> request, std::chrono::milliseconds timeout)
+			: connection{ connection }, loop{ connection.loop }, request{ std::move(request) }, timeout{ timeout } {}
+		bool await_ready() const noexcept { return !connection.connected; }
+		void await_suspend(std::coroutine_handle<> coroutine);
+		std::unique_ptr<SnackerEngine::SERPResponse> await_resume() { scheduled = false; return std::move(response); }
+		~RequestAwaiter();
+		RequestAwaiter(const RequestAwaiter& other) = delete;
+		RequestAwaiter& operator=(const RequestAwaiter& other) = delete;
+	};
+	/// Handler for requests sent to us by other clients. Is started as a separate task for each request.
+	using RequestHandler = std::function<Task<void>(AsyncSERPConnection& connection, std::unique_ptr<SnackerEngine::SERPRequest> request)>;
+private:
+	SERPEventLoop& loop;
+	SnackerEngine::SERPEndpoint endpoint;
+	SnackerEngine::SERPID serpID;
+	bool connected = true;
+	/// Requests waiting for a response, by destination in the order they were sent. Requests that timed out
+	/// are nullptr, they keep their place until their response arrives.
+	std::unordered_map<uint16_t, std::deque<RequestAwaiter*>> pendingRequests;
+	std::size_t numberOfPendingRequests = 0;
+	RequestHandler requestHandler;
+	/// Private constructor, use connect()
+	AsyncSERPConnection(SERPEventLoop& loop, SnackerEngine::SocketTCP socket);
+	/// Sends the request of the given awaiter and registers it. Returns false if it could not be sent.
+	bool sendRequest(RequestAwaiter& awaiter);
+	/// Unregisters a pending request and resumes it with the given response (nullptr on timeout). A request
+	/// that timed out keeps its place in the queue of its destination.
+	void completeRequest(RequestAwaiter& awaiter, std::unique_ptr<SnackerEngine::SERPResponse> response);
+	/// Matches a received response with the oldest request to its source
+	void handleResponse(std::unique_ptr<SnackerEngine::SERPResponse> response);
+	/// Called by the event loop when the socket is readable/writable
+	void onReadable();
+	void onWritable();
+public:
+	/// Connects to the server at the given IPv4 address and port and registers the connection with the loop.
+	/// Returns nullptr on failure.
+	static std::unique_ptr<AsyncSERPConnection> connect(SERPEventLoop& loop, const std::string& address, uint16_t port);
+	/// Asks the server for our SERPID. Must be awaited before requests to other clients are sent.
+	Task<bool> start();
+	/// Sends a request and returns an awaitable for its response
+	RequestAwaiter request(SnackerEngine::SERPID destination, SnackerEngine::RequestStatusCode requestStatusCode, const std::string& target,
+		SnackerEngine::Buffer body = SnackerEngine::Buffer(), std::chrono::milliseconds timeout = std::chrono::milliseconds(5000));
+	/// Answers a request that was received from another client
+	bool respond(const SnackerEngine::SERPRequest& request, SnackerEngine::ResponseStatusCode responseStatusCode, const SnackerEngine::Buffer& body = SnackerEngine::Buffer());
+	/// Sets the handler for incoming requests. Without a handler, requests are answered with NOT_FOUND.
+	void setRequestHandler(RequestHandler handler) { requestHandler = std::move(handler); }
+	/// Returns our SERPID (only valid after start())
+	SnackerEngine::SERPID getSerpID() const { return serpID; }
+	bool isConnected() const { return connected; }
+	/// Returns the number of requests waiting for a response
+	std::size_t getNumberOfPendingRequests() const { return numberOfPendingRequests; }
+	/// Closes the connection. All pending requests result in nullptr.
+	void close();
+	/// Destructor, closes the connection
+	~AsyncSERPConnection();
+	/// Deleted Copy and move constructors and assignment operators
+	AsyncSERPConnection(AsyncSERPConnection& other) = delete;
+	AsyncSERPConnection(AsyncSERPConnection&& other) = delete;
+	AsyncSERPConnection& operator=(AsyncSERPConnection& other) = delete;
+	AsyncSERPConnection& operator=(AsyncSERPConnection&& other) = delete;
+};
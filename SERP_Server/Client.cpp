@@ -1,26 +1,58 @@
 #include "Client.h"
+#include "IoThread.h"
 #include <iostream>
 
+#ifdef _LINUX
+	#include <linux/errqueue.h>
+	#include <sys/socket.h>
+#endif // _LINUX
+
+std::atomic<std::size_t> Client::numberOfLiveClients = 0;
+
 void Client::runSenderThread()
 {
+#ifdef _LINUX
+	// Pin the thread before it allocates anything, st. its buffers are placed on the node of the client
+	if (cpuPlacement) cpuPlacement->pinCurrentThread(numaNode);
+#endif // _LINUX
 	while (connected) {
 		std::unique_lock<std::mutex> lock(mutex);
+#ifdef _LINUX
+		// While zero copy sends are pending we have to wake up regularly to release their buffers
+		if (!zeroCopyBuffers.empty()) {
+			conditionVariable.wait_for(lock, std::chrono::milliseconds(zeroCopyReapInterval));
+			reapZeroCopyCompletions();
+		}
+		else conditionVariable.wait(lock);
+#else
 		conditionVariable.wait(lock);
+#endif // _LINUX
 		// Check if we are still connected
 		if (!connected) return;
 		// We have the lock and can process the first element in the messagesToBeSent vector.
-		std::unique_ptr<SnackerEngine::SERPMessage> message = nullptr;
+		OutgoingMessage message{};
 		if (!messagesToBeSent.empty()) {
 			message = std::move(messagesToBeSent.front());
 			messagesToBeSent.pop();
 		}
+		bool hasMessage = message.message || message.serialized;
+#ifdef _LINUX
+		// If more messages are waiting, hold back partial segments until the whole batch is written
+		bool corked = hasMessage && !messagesToBeSent.empty() && shouldCork();
+#endif // _LINUX
 		// Before we send, unlock the queue again, st. other threads don't have to wait
 		lock.unlock();
+		// The wakeup could have been spurious or a timeout
+		if (!hasMessage) continue;
+#ifdef _LINUX
+		if (corked) setSocketCork(endpoint.getTCPEndpoint().getSocket(), true);
+#endif // _LINUX
 		// Now we can send the message
-		endpoint.finalizeAndSendMessage(*message, false);
+		sendMessageNow(message);
+		updateUnsentBytes();
 		// Check if there are now more messages we can send
 		while (true) {
-			std::unique_ptr<SnackerEngine::SERPMessage> message = nullptr;
+			OutgoingMessage message{};
 			{
 				std::lock_guard lockGuard(mutex);
 				if (!messagesToBeSent.empty()) {
@@ -31,38 +63,299 @@ void Client::runSenderThread()
 			// If we are disconnected, stop the thread
 			if (!connected) return;
 			// If the queue was empty, leave the loop
-			if (!message) break;
+			if (!message.message && !message.serialized) break;
 			// Else just keep sending messages
-			endpoint.finalizeAndSendMessage(*message, false);
+			sendMessageNow(message);
+			updateUnsentBytes();
+		}
+		// A peer that stopped reading never frees the socket buffer. Stop flushing once we are disconnected,
+		// else disconnect() waits for this thread forever.
+		while (connected && endpoint.hasUnsentMessages()) endpoint.updateSend();
+		updateUnsentBytes();
+#ifdef _LINUX
+		// The queue is empty, send out the rest of the batch
+		if (corked) setSocketCork(endpoint.getTCPEndpoint().getSocket(), false);
+#endif // _LINUX
+	}
+}
+
+bool Client::isReceivingPaused() const
+{
+	return memoryAccount->paused || connectionChangePending;
+}
+
+void Client::updateUnsentBytes()
+{
+	if (!endpoint.hasUnsentMessages()) endpointBytes = 0;
+	if (memoryBudget) memoryBudget->set(memoryAccount->unsentBytes, endpointBytes);
+}
+
+#ifdef _LINUX
+bool Client::shouldCork() const
+{
+	return socketProfile.corkBatches && !local && !sharedMemoryAttached;
+}
+#endif // _LINUX
+
+void Client::sendMessageNow(OutgoingMessage& message)
+{
+	if (message.serialized) sendSerializedMessageNow(*message.serialized);
+	else sendMessageNow(*message.message);
+}
+
+void Client::sendSerializedMessageNow(const SnackerEngine::Buffer& serialized)
+{
+#ifdef _LINUX
+	if (sharedMemoryAttached) {
+		if (sharedMemoryChannel->sendSerializedMessage(serialized, sharedMemorySendTimeout)) return;
+		sendBytesNow(serialized);
+		sharedMemoryChannel->ringDoorbell();
+		return;
+	}
+#endif // _LINUX
+	sendBytesNow(serialized);
+}
+
+void Client::sendBytesNow(const SnackerEngine::Buffer& data)
+{
+	// Everything the endpoint still holds has to go out first to keep the order of messages
+	while (connected && endpoint.hasUnsentMessages()) endpoint.updateSend();
+	auto socket = endpoint.getTCPEndpoint().getSocket().sock;
+	std::size_t offset = 0;
+	while (offset < data.size() && connected) {
+#ifdef _WINDOWS
+		int result = send(socket, reinterpret_cast<const char*>(data.data()) + offset, static_cast<int>(data.size() - offset), 0);
+		if (result > 0) {
+			offset += static_cast<std::size_t>(result);
+			continue;
+		}
+		if (result == SOCKET_ERROR && WSAGetLastError() == WSAEWOULDBLOCK) {
+			// Wait for space in the send buffer
+			WSAPOLLFD fileDescriptorSending{ socket, POLLWRNORM, 0 };
+			WSAPoll(&fileDescriptorSending, 1, 1000);
+			continue;
+		}
+#endif // _WINDOWS
+#ifdef _LINUX
+		ssize_t result = send(socket, data.data() + offset, data.size() - offset, MSG_NOSIGNAL);
+		if (result > 0) {
+			offset += static_cast<std::size_t>(result);
+			continue;
+		}
+		if (result == -1 && errno == EAGAIN) {
+			// Wait for space in the send buffer
+			pollfd fileDescriptorSending{ socket, POLLOUT, 0 };
+			poll(&fileDescriptorSending, 1, 1000);
+			continue;
+		}
+#endif // _LINUX
+		// On any other error the socket is broken. The receiver thread notices that and disconnects us.
+		break;
+	}
+}
+
+void Client::sendMessageNow(SnackerEngine::SERPMessage& message)
+{
+#ifdef _LINUX
+	if (sharedMemoryAttached) {
+		if (sharedMemoryChannel->sendMessage(message, sharedMemorySendTimeout)) return;
+		// The message is too large for the ring (or the client is not reading). Send it over the
+		// socket and tell the client to look there.
+		endpoint.finalizeAndSendMessage(message, false);
+		while (connected && endpoint.hasUnsentMessages()) endpoint.updateSend();
+		sharedMemoryChannel->ringDoorbell();
+		return;
+	}
+	if (zeroCopyEnabled && zeroCopyThreshold > 0 && message.content.size() >= zeroCopyThreshold) {
+		sendMessageZeroCopy(message);
+		return;
+	}
+#endif // _LINUX
+	endpoint.finalizeAndSendMessage(message, false);
+	endpointBytes += MemoryBudget::getMessageSize(message);
+}
+
+#ifdef _LINUX
+void Client::sendMessageZeroCopy(SnackerEngine::SERPMessage& message)
+{
+	// Everything the endpoint still holds has to go out first to keep the order of messages
+	while (connected && endpoint.hasUnsentMessages()) endpoint.updateSend();
+	int socket = endpoint.getTCPEndpoint().getSocket().sock;
+	SnackerEngine::Buffer buffer = message.serialize();
+	uint32_t firstNotificationID = nextZeroCopyNotificationID;
+	std::size_t offset = 0;
+	while (offset < buffer.size() && connected) {
+		ssize_t result = send(socket, buffer.data() + offset, buffer.size() - offset, MSG_ZEROCOPY | MSG_NOSIGNAL);
+		if (result > 0) {
+			// Every successful call gets its own notification ID, even if only part of the data was sent
+			offset += static_cast<std::size_t>(result);
+			nextZeroCopyNotificationID++;
+			continue;
+		}
+		if (result == -1 && errno == EAGAIN) {
+			// Wait for space in the send buffer. POLLERR signals pending completions on the error queue.
+			pollfd fileDescriptorSending{ socket, POLLOUT, 0 };
+			poll(&fileDescriptorSending, 1, static_cast<int>(zeroCopyReapInterval));
+			reapZeroCopyCompletions();
+		}
+		else if (result == -1 && errno == ENOBUFS) {
+			// Too many pinned pages (optmem limit). Release what we can and copy this chunk instead.
+			reapZeroCopyCompletions();
+			result = send(socket, buffer.data() + offset, buffer.size() - offset, MSG_NOSIGNAL);
+			if (result > 0) offset += static_cast<std::size_t>(result);
+			else if (errno != EAGAIN) break;
+		}
+		// On any other error the socket is broken. The receiver thread notices that and disconnects us.
+		else break;
+	}
+	if (nextZeroCopyNotificationID != firstNotificationID) {
+		if (memoryBudget) memoryBudget->add(memoryAccount->zeroCopyBytes, buffer.size());
+		zeroCopyBuffers.push_back(ZeroCopyBuffer{ std::move(buffer), firstNotificationID, nextZeroCopyNotificationID - 1, nextZeroCopyNotificationID - firstNotificationID });
+	}
+	reapZeroCopyCompletions();
+}
+
+void Client::reapZeroCopyCompletions()
+{
+	int socket = endpoint.getTCPEndpoint().getSocket().sock;
+	while (!zeroCopyBuffers.empty()) {
+		char control[CMSG_SPACE(sizeof(sock_extended_err))];
+		msghdr messageHeader{};
+		messageHeader.msg_control = control;
+		messageHeader.msg_controllen = sizeof(control);
+		if (recvmsg(socket, &messageHeader, MSG_ERRQUEUE | MSG_DONTWAIT) == -1) break;
+		for (cmsghdr* controlMessage = CMSG_FIRSTHDR(&messageHeader); controlMessage; controlMessage = CMSG_NXTHDR(&messageHeader, controlMessage)) {
+			const sock_extended_err* error = reinterpret_cast<const sock_extended_err*>(CMSG_DATA(controlMessage));
+			if (error->ee_errno != 0 || error->ee_origin != SO_EE_ORIGIN_ZEROCOPY) continue;
+			// The kernel reports the inclusive range [ee_info, ee_data] of completed notification IDs
+			uint32_t first = error->ee_info;
+			uint32_t last = error->ee_data;
+			for (auto it = zeroCopyBuffers.begin(); it != zeroCopyBuffers.end();) {
+				uint32_t overlapBegin = std::max(first, it->firstNotificationID);
+				uint32_t overlapEnd = std::min(last, it->lastNotificationID);
+				if (overlapBegin <= overlapEnd) it->outstandingNotifications -= overlapEnd - overlapBegin + 1;
+				if (it->outstandingNotifications == 0) {
+					if (memoryBudget) memoryBudget->remove(memoryAccount->zeroCopyBytes, it->buffer.size());
+					it = zeroCopyBuffers.erase(it);
+				}
+				else ++it;
+			}
 		}
-		while (endpoint.hasUnsentMessages()) endpoint.updateSend();
 	}
 }
+#endif // _LINUX
+
+#ifdef _LINUX
+std::optional<std::string> Client::createSharedMemory(uint64_t ringCapacity)
+{
+	if (sharedMemoryChannel) return {};
+	// The segment is made accessible to the user of the process on the other end of the socket only
+	ucred credentials{};
+	socklen_t credentialsLength = sizeof(credentials);
+	if (getsockopt(endpoint.getTCPEndpoint().getSocket().sock, SOL_SOCKET, SO_PEERCRED, &credentials, &credentialsLength) == -1) return {};
+	sharedMemoryChannel = SharedMemoryChannel::create(ringCapacity, credentials.uid);
+	if (!sharedMemoryChannel) return {};
+	return sharedMemoryChannel->getName();
+}
+#endif // _LINUX
+
+void Client::notifySender()
+{
+#ifdef _IO_URING
+	if (ioThread) {
+		ioThread->notifyMessages(*this);
+		return;
+	}
+#endif // _IO_URING
+	conditionVariable.notify_one();
+}
+
+bool Client::hasSocketError()
+{
+	int error = 0;
+#ifdef _WINDOWS
+	int length = sizeof(error);
+	if (getsockopt(endpoint.getTCPEndpoint().getSocket().sock, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &length) != 0) return true;
+#endif // _WINDOWS
+#ifdef _LINUX
+	socklen_t length = sizeof(error);
+	if (getsockopt(endpoint.getTCPEndpoint().getSocket().sock, SOL_SOCKET, SO_ERROR, &error, &length) == -1) return true;
+#endif // _LINUX
+	return error != 0;
+}
 
 void Client::disconnect()
 {
 	connected = false;
+#ifdef _IO_URING
+	// The I/O thread sets receiverThreadFinished once it released the socket
+	if (ioThread) {
+		ioThread->removeClient(*this);
+		return;
+	}
+#endif // _IO_URING
 	conditionVariable.notify_one();
 	senderThread.join();
 }
 
-void Client::sendMesage(std::unique_ptr<SnackerEngine::SERPMessage> message)
+void Client::sendMesage(std::unique_ptr<SnackerEngine::SERPMessage> message, std::shared_ptr<MemoryAccount> sender)
 {
+	MemoryCharge charge = memoryBudget ? MemoryCharge(*memoryBudget, memoryAccount, std::move(sender), MemoryBudget::getMessageSize(*message)) : MemoryCharge();
 	{
 		std::lock_guard lockGuard(mutex);
-		messagesToBeSent.push(std::move(message));
+		messagesToBeSent.push(OutgoingMessage{ std::move(message), nullptr, std::move(charge) });
 	}
-	conditionVariable.notify_one();
+	notifySender();
+}
+
+void Client::sendMessages(std::vector<std::unique_ptr<SnackerEngine::SERPMessage>> messages)
+{
+	{
+		std::lock_guard lockGuard(mutex);
+		for (auto& message : messages) {
+			MemoryCharge charge = memoryBudget ? MemoryCharge(*memoryBudget, memoryAccount, nullptr, MemoryBudget::getMessageSize(*message)) : MemoryCharge();
+			messagesToBeSent.push(OutgoingMessage{ std::move(message), nullptr, std::move(charge) });
+		}
+	}
+	notifySender();
 }
 
-Client::Client(SnackerEngine::SocketTCP socket, SnackerEngine::SERPID serpID)
+void Client::sendSerializedMessage(std::shared_ptr<const SnackerEngine::Buffer> serialized)
+{
+	{
+		std::lock_guard lockGuard(mutex);
+		// Shared messages are charged once by whoever created them
+		messagesToBeSent.push(OutgoingMessage{ nullptr, std::move(serialized), MemoryCharge() });
+	}
+	notifySender();
+}
+
+Client::Client(SnackerEngine::SocketTCP socket, SnackerEngine::SERPID serpID, bool local, const SocketProfile& socketProfile)
 	: endpoint{ std::move(socket) }, serpID{ serpID }, messagesToBeSent{}, senderThread{}, receiverThread{}, 
-	mutex{}, conditionVariable{}, connected{ true }, receiverThreadFinished{ false}, fileDescriptorRecievingMessages {}
+	mutex{}, conditionVariable{}, connected{ true }, receiverThreadFinished{ false}, fileDescriptorRecievingMessages {},
+	local{ local }, socketProfile{ socketProfile }, compressionCodec{ CompressionCodec::NONE }
+#ifdef _LINUX
+	, sharedMemoryChannel{ nullptr }, sharedMemoryAttached{ false }, zeroCopyEnabled{ false }, zeroCopyBuffers{}
+#endif // _LINUX
 {
+	numberOfLiveClients++;
 	SnackerEngine::setToNonBlocking(endpoint.getTCPEndpoint().getSocket());
+#ifdef _LINUX
+	int enable = 1;
+	zeroCopyEnabled = setsockopt(endpoint.getTCPEndpoint().getSocket().sock, SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(enable)) == 0;
+#endif // _LINUX
 }
 
 Client::~Client()
 {
-	receiverThread.join();
+	// The receiver thread holds a reference to the client, it can be the one that destroys it
+	// Clients served by an I/O thread have no threads of their own
+	if (receiverThread.get_id() == std::this_thread::get_id()) receiverThread.detach();
+	else if (receiverThread.joinable()) receiverThread.join();
+	// Queued messages release their charges themselves, the endpoint and zero copy buffers are released here
+	if (memoryBudget) {
+		memoryBudget->set(memoryAccount->unsentBytes, 0);
+		memoryBudget->set(memoryAccount->zeroCopyBytes, 0);
+	}
+	numberOfLiveClients--;
 }
\ No newline at end of file
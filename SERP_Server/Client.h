@@ -1,23 +1,46 @@
+#pragma once
 #include "Network/SERP/SERPEndpoint.h"
+#include "SharedMemoryChannel.h"
+#include "IoUring.h"
+#include "Compression.h"
+#include "SocketTuning.h"
+#include "CpuPlacement.h"
+#include "MemoryBudget.h"
 #include <mutex>
 #include <condition_variable>
 #include <queue>
+#include <chrono>
+#include <functional>
 
 #ifdef _LINUX
 	#include <poll.h>
+	#include <list>
 #endif // _LINUX
 
+class IoThread;
+
 /// This class represents a connected client.
 class Client
 {
 private:
 	friend class Server;
+	friend class IoThread;
 	/// The endpoint through which data is both received and sent.
 	SnackerEngine::SERPEndpoint endpoint;
-	/// The SERPID of this client.
+	/// The SERPID of this client. Only changed by a reclaim request while clientsMapMutex is held and the
+	/// messages of the client are held back (see connectionChangePending).
 	SnackerEngine::SERPID serpID;
+	/// A message waiting to be sent. Broadcasts are serialized only once, the serialized message is then
+	/// shared by the queues of all clients (and message is nullptr).
+	struct OutgoingMessage
+	{
+		std::unique_ptr<SnackerEngine::SERPMessage> message;
+		std::shared_ptr<const SnackerEngine::Buffer> serialized;
+		/// Memory charged for message, released once the message was sent
+		MemoryCharge charge;
+	};
 	/// Vector of messages to be sent.
-	std::queue<std::unique_ptr<SnackerEngine::SERPMessage>> messagesToBeSent;
+	std::queue<OutgoingMessage> messagesToBeSent;
 	/// threads responsible for sending/receiving messages
 	std::thread senderThread;
 	std::thread receiverThread;
@@ -28,18 +51,123 @@ private:
 	std::atomic<bool> connected;
 	/// atomic boolean that is set to true when the receiver thread has finished executing
 	std::atomic<bool> receiverThreadFinished;
+	/// Time at which the client was disconnected (set by the server)
+	std::chrono::steady_clock::time_point disconnectTime;
+	/// Number of Client objects that currently exist, including disconnected clients that were not reaped yet
+	static std::atomic<std::size_t> numberOfLiveClients;
 	/// Filedescriptor for receiving messages
 	pollfd fileDescriptorRecievingMessages;
+	/// true if the client connected through the local (AF_UNIX) socket of the server
+	bool local;
+	/// Socket options of this client (only corkBatches is used after the socket was set up)
+	SocketProfile socketProfile;
+	/// Memory budget of the server (set before the threads are started) and the memory held for this client
+	MemoryBudget* memoryBudget = nullptr;
+	std::shared_ptr<MemoryAccount> memoryAccount = std::make_shared<MemoryAccount>();
+	/// Accounted size of the messages handed to the endpoint since it last had no unsent data. The endpoint
+	/// does not tell how much of them it still holds, so they stay charged until it sent everything. Only
+	/// used by the sender thread.
+	std::size_t endpointBytes = 0;
+	/// Helper function that updates the accounted size of the unsent messages of the endpoint
+	void updateUnsentBytes();
+	/// Requests of this client to the server that wait for the worker pool, in the order they were received.
+	/// Only one worker at a time handles them (serverRequestsRunning), st. the responses keep their order.
+	/// Guarded by serverRequestMutex.
+	std::queue<std::function<void()>> serverRequests;
+	bool serverRequestsRunning = false;
+	std::mutex serverRequestMutex;
+	/// true while a request that changes the connection (reclaim, sharedMemory) waits in serverRequests or
+	/// is handled. The thread that receives the messages of the client stops reading until it is reset and
+	/// keeps the rest of the current batch in heldMessages, which only that thread accesses.
+	std::atomic<bool> connectionChangePending = false;
+	std::vector<std::unique_ptr<SnackerEngine::SERPMessage>> heldMessages;
+	/// Returns true if the socket of the client should not be read at the moment (memory pressure or a
+	/// pending connection change)
+	bool isReceivingPaused() const;
+	/// true if requests of this client to disconnected clients with a session are stored until they reconnect
+	std::atomic<bool> storeAndForward = false;
+	/// Codec the client negotiated for compressed message bodies (NONE until negotiated)
+	std::atomic<CompressionCodec> compressionCodec;
+#ifdef _LINUX
+	/// Optional shared memory transport for clients on the same host. Is only set once, while the
+	/// receiver thread is paused. The receiver thread reads from the ring from then on, the sender thread only
+	/// writes to it once sharedMemoryAttached is true, which is set when the client has written its
+	/// first record and therefore has mapped the segment.
+	std::unique_ptr<SharedMemoryChannel> sharedMemoryChannel;
+	std::atomic<bool> sharedMemoryAttached;
+	/// Placement of the client threads (nullptr if threads are not pinned) and the index of the NUMA node
+	/// the client was assigned to
+	CpuPlacement* cpuPlacement = nullptr;
+	int numaNode = -1;
+	/// Time in ms the sender thread waits for the client to free space in the shared memory ring
+	int sharedMemorySendTimeout = 1000;
+	/// Messages with a content of at least this many bytes are sent with MSG_ZEROCOPY (0 disables zero copy sends)
+	std::size_t zeroCopyThreshold = 256 * 1024;
+	/// true if SO_ZEROCOPY could be enabled on the socket (not supported on AF_UNIX sockets)
+	bool zeroCopyEnabled;
+	/// A buffer handed to the kernel with MSG_ZEROCOPY. It must stay alive until the kernel has
+	/// reported completion of all sends (notification IDs) that referenced it.
+	struct ZeroCopyBuffer
+	{
+		SnackerEngine::Buffer buffer;
+		uint32_t firstNotificationID;
+		uint32_t lastNotificationID;
+		uint32_t outstandingNotifications;
+	};
+	std::list<ZeroCopyBuffer> zeroCopyBuffers;
+	/// The notification ID the kernel will assign to the next zero copy send
+	uint32_t nextZeroCopyNotificationID = 0;
+	/// Interval in ms in which the sender thread checks for completions while zero copy buffers are pending
+	unsigned zeroCopyReapInterval = 10;
+	/// Helper function that sends a message with MSG_ZEROCOPY (only called by the sender thread)
+	void sendMessageZeroCopy(SnackerEngine::SERPMessage& message);
+	/// Reads completion notifications from the socket error queue and releases finished buffers
+	void reapZeroCopyCompletions();
+#endif // _LINUX
+#ifdef _IO_URING
+	/// The I/O thread that serves this client (nullptr if the client has its own sender and receiver
+	/// thread), and a flag that is true while the I/O thread was told about queued messages
+	IoThread* ioThread = nullptr;
+	std::atomic<bool> ioThreadNotified = false;
+#endif // _IO_URING
+#ifdef _LINUX
+	/// true if the socket should be corked while a batch of messages is sent
+	bool shouldCork() const;
+#endif // _LINUX
+	/// Helper function that sends a single message over the best available transport.
+	void sendMessageNow(SnackerEngine::SERPMessage& message);
+	void sendMessageNow(OutgoingMessage& message);
+	/// Helper function that sends an already serialized message over the best available transport.
+	void sendSerializedMessageNow(const SnackerEngine::Buffer& serialized);
+	/// Helper function that writes the given bytes directly to the socket, after everything the endpoint
+	/// still holds. Blocks until everything was written or the socket broke.
+	void sendBytesNow(const SnackerEngine::Buffer& data);
+	/// Helper function that wakes up whoever sends the queued messages (the sender thread or the I/O thread)
+	void notifySender();
+	/// Returns true if an error is pending on the socket (SO_ERROR). Completions of zero copy sends make
+	/// poll() report POLLERR as well, but they don't set an error.
+	bool hasSocketError();
 	/// Function that is continuously run by a sender thread during the lifetime of the Client.
 	void runSenderThread();
 	/// Helper function that cleans up loose end when disconnecting a client. Should be
 	/// called before the client is deleted.
 	void disconnect();
 public:
-	/// Puts the given message into the messagesToBeSent vector and wakes up the sender thread.
-	void sendMesage(std::unique_ptr<SnackerEngine::SERPMessage> message);
-	/// Constructor
-	Client(SnackerEngine::SocketTCP socket, SnackerEngine::SERPID serpID);
+	/// Puts the given message into the messagesToBeSent vector and wakes up the sender thread. If the message
+	/// is relayed, sender is the account of the client that sent it.
+	void sendMesage(std::unique_ptr<SnackerEngine::SERPMessage> message, std::shared_ptr<MemoryAccount> sender = nullptr);
+	/// Puts all given messages into the messagesToBeSent vector at once and wakes up the sender thread.
+	void sendMessages(std::vector<std::unique_ptr<SnackerEngine::SERPMessage>> messages);
+	/// Puts an already serialized message into the messagesToBeSent vector and wakes up the sender thread.
+	/// The buffer may be shared with other clients.
+	void sendSerializedMessage(std::shared_ptr<const SnackerEngine::Buffer> serialized);
+#ifdef _LINUX
+	/// Creates a shared memory segment with the given ring capacity for this client and returns its name.
+	/// Returns std::nullopt if the segment could not be created or a segment was already created.
+	std::optional<std::string> createSharedMemory(uint64_t ringCapacity);
+#endif // _LINUX
+	/// Constructor. The socket profile must already be applied to the socket.
+	Client(SnackerEngine::SocketTCP socket, SnackerEngine::SERPID serpID, bool local = false, const SocketProfile& socketProfile = {});
 	/// Destructor
 	~Client();
 	/// Deleted Copy and move constructors and assignment operators
@@ -0,0 +1,100 @@
+#include "Compression.h"
+#include <cstring>
+
+#ifdef _COMPRESSION
+	#include <zlib.h>
+#endif // _COMPRESSION
+
+/// Magic number at the beginning of a frame. Starts with a byte that is invalid in UTF-8, st. text bodies
+/// never have to be escaped.
+static constexpr std::byte frameMagic[] = { std::byte{ 0xFF }, std::byte{ 'S' }, std::byte{ 'Z' }, std::byte{ 0x01 } };
+/// Size of the frame header: magic number, codec and uncompressed size
+static constexpr std::size_t frameHeaderLength = sizeof(frameMagic) + sizeof(uint8_t) + sizeof(uint32_t);
+
+/// Helper function that writes the frame header into output, which must be large enough
+static void writeFrameHeader(CompressionCodec codec, uint32_t uncompressedSize, SnackerEngine::Buffer& output)
+{
+	std::memcpy(output.data(), frameMagic, sizeof(frameMagic));
+	output.data()[sizeof(frameMagic)] = static_cast<std::byte>(codec);
+	std::memcpy(output.data() + sizeof(frameMagic) + sizeof(uint8_t), &uncompressedSize, sizeof(uncompressedSize));
+}
+
+std::optional<CompressionCodec> parseCompressionCodec(const std::string& name)
+{
+	if (name == "none") return CompressionCodec::NONE;
+#ifdef _COMPRESSION
+	if (name == "deflate") return CompressionCodec::DEFLATE;
+#endif // _COMPRESSION
+	return {};
+}
+
+std::string to_string(CompressionCodec codec)
+{
+	switch (codec)
+	{
+	case CompressionCodec::DEFLATE: return "deflate";
+	default: return "none";
+	}
+}
+
+bool isFramedBody(const SnackerEngine::Buffer& body)
+{
+	return body.size() >= sizeof(frameMagic) && std::memcmp(body.data(), frameMagic, sizeof(frameMagic)) == 0;
+}
+
+std::optional<CompressionCodec> getFrameCodec(const SnackerEngine::Buffer& body)
+{
+	if (!isFramedBody(body) || body.size() < frameHeaderLength) return {};
+	uint8_t codec = static_cast<uint8_t>(body.data()[sizeof(frameMagic)]);
+	if (codec > static_cast<uint8_t>(CompressionCodec::DEFLATE)) return {};
+	return static_cast<CompressionCodec>(codec);
+}
+
+bool compressBuffer(CompressionCodec codec, const SnackerEngine::Buffer& input, SnackerEngine::Buffer& output, int level)
+{
+	if (input.size() > UINT32_MAX) return false;
+	uint32_t uncompressedSize = static_cast<uint32_t>(input.size());
+	if (codec == CompressionCodec::NONE) {
+		output.resize(frameHeaderLength + input.size());
+		writeFrameHeader(codec, uncompressedSize, output);
+		if (input.size() > 0) std::memcpy(output.data() + frameHeaderLength, input.data(), input.size());
+		return true;
+	}
+#ifdef _COMPRESSION
+	if (codec != CompressionCodec::DEFLATE) return false;
+	uLongf compressedSize = compressBound(static_cast<uLong>(input.size()));
+	output.resize(frameHeaderLength + compressedSize);
+	writeFrameHeader(codec, uncompressedSize, output);
+	if (compress2(reinterpret_cast<Bytef*>(output.data()) + frameHeaderLength, &compressedSize,
+		reinterpret_cast<const Bytef*>(input.data()), static_cast<uLong>(input.size()), level) != Z_OK) return false;
+	output.resize(frameHeaderLength + compressedSize);
+	return true;
+#else
+	return false;
+#endif // _COMPRESSION
+}
+
+bool decompressBuffer(const SnackerEngine::Buffer& input, SnackerEngine::Buffer& output, std::size_t maxSize)
+{
+	std::optional<CompressionCodec> codec = getFrameCodec(input);
+	if (!codec.has_value()) return false;
+	uint32_t uncompressedSize = 0;
+	std::memcpy(&uncompressedSize, input.data() + sizeof(frameMagic) + sizeof(uint8_t), sizeof(uncompressedSize));
+	// Don't trust the size, else a small message could make us allocate gigabytes
+	if (uncompressedSize > maxSize) return false;
+	if (codec.value() == CompressionCodec::NONE) {
+		if (input.size() - frameHeaderLength != uncompressedSize) return false;
+		output.resize(uncompressedSize);
+		if (uncompressedSize > 0) std::memcpy(output.data(), input.data() + frameHeaderLength, uncompressedSize);
+		return true;
+	}
+#ifdef _COMPRESSION
+	output.resize(uncompressedSize);
+	uLongf outputSize = uncompressedSize;
+	if (uncompress(reinterpret_cast<Bytef*>(output.data()), &outputSize,
+		reinterpret_cast<const Bytef*>(input.data()) + frameHeaderLength, static_cast<uLong>(input.size() - frameHeaderLength)) != Z_OK) return false;
+	return outputSize == uncompressedSize;
+#else
+	return false;
+#endif // _COMPRESSION
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "Utility/Buffer.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+
+/// Codecs a connection can negotiate for compressing message bodies. SERP headers have no room for a
+/// flag, so compressed bodies are marked in-band: a framed body starts with a magic number, followed by
+/// the codec (uint8), the uncompressed size (uint32, little endian) and the compressed data. Frames are
+/// only used on connections that negotiated a codec. A body of codec NONE is stored uncompressed, it
+/// escapes plain bodies that happen to start with the magic number.
+enum class CompressionCodec : uint8_t
+{
+	NONE,
+	DEFLATE,
+};
+
+/// Returns the codec with the given name ("none", "deflate") or std::nullopt if it is unknown or was not
+/// compiled in
+std::optional<CompressionCodec> parseCompressionCodec(const std::string& name);
+/// Returns the name of the given codec
+std::string to_string(CompressionCodec codec);
+/// Returns true if the given body starts with the magic number of a frame
+bool isFramedBody(const SnackerEngine::Buffer& body);
+/// Returns the codec of the given framed body, or std::nullopt if it is no valid frame
+std::optional<CompressionCodec> getFrameCodec(const SnackerEngine::Buffer& body);
+/// Compresses input into a frame of the given codec in output. Codec NONE frames input without
+/// compressing it. Returns false if the codec is not supported.
+bool compressBuffer(CompressionCodec codec, const SnackerEngine::Buffer& input, SnackerEngine::Buffer& output, int level = 6);
+/// Decompresses the frame input into output. Returns false if the frame is invalid, its codec is not
+/// supported or it would decompress to more than maxSize bytes.
+bool decompressBuffer(const SnackerEngine::Buffer& input, SnackerEngine::Buffer& output, std::size_t maxSize);
@@ -0,0 +1,152 @@
+#include "CpuPlacement.h"
+
+#ifdef _LINUX
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <charconv>
+#include <thread>
+#include <sched.h>
+#include <sys/socket.h>
+
+std::optional<std::vector<int>> parseCpuList(const std::string& cpuList)
+{
+	std::vector<int> cpus;
+	std::size_t start = 0;
+	while (start < cpuList.size()) {
+		std::size_t end = cpuList.find(',', start);
+		if (end == std::string::npos) end = cpuList.size();
+		std::string range = cpuList.substr(start, end - start);
+		std::size_t dash = range.find('-');
+		int first = 0, last = 0;
+		const char* rangeEnd = range.data() + range.size();
+		auto firstResult = std::from_chars(range.data(), dash == std::string::npos ? rangeEnd : range.data() + dash, first);
+		if (firstResult.ec != std::errc() || first < 0) return {};
+		if (dash == std::string::npos) last = first;
+		else {
+			auto lastResult = std::from_chars(range.data() + dash + 1, rangeEnd, last);
+			if (lastResult.ec != std::errc() || lastResult.ptr != rangeEnd || last < first) return {};
+		}
+		if (dash == std::string::npos && firstResult.ptr != rangeEnd) return {};
+		// cpu_set_t can't hold more CPUs anyway, and a huge range like "0-2000000000" must not make us allocate
+		if (last >= CPU_SETSIZE) return {};
+		for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+		start = end + 1;
+	}
+	std::sort(cpus.begin(), cpus.end());
+	cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+	if (cpus.empty()) return {};
+	return cpus;
+}
+
+int CpuPlacement::getNodeIndexOfCpu(int cpu) const
+{
+	for (std::size_t i = 0; i < nodes.size(); ++i) {
+		if (std::binary_search(nodes[i].cpus.begin(), nodes[i].cpus.end(), cpu)) return static_cast<int>(i);
+	}
+	return -1;
+}
+
+std::unique_ptr<CpuPlacement> CpuPlacement::create(const std::string& cpuList)
+{
+	auto cpus = parseCpuList(cpuList);
+	if (!cpus.has_value()) return nullptr;
+	std::unique_ptr<CpuPlacement> placement(new CpuPlacement());
+	// Only keep CPUs that exist (and that we are allowed to run on)
+	cpu_set_t availableCpus;
+	CPU_ZERO(&availableCpus);
+	if (sched_getaffinity(0, sizeof(availableCpus), &availableCpus) != 0) return nullptr;
+	for (int cpu : cpus.value()) {
+		if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &availableCpus)) placement->allCpus.push_back(cpu);
+	}
+	if (placement->allCpus.empty()) return nullptr;
+	// Group the CPUs by NUMA node
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator("/sys/devices/system/node", error)) {
+		std::string name = entry.path().filename().string();
+		if (!name.starts_with("node")) continue;
+		int id = 0;
+		if (std::from_chars(name.data() + 4, name.data() + name.size(), id).ec != std::errc()) continue;
+		std::ifstream file(entry.path() / "cpulist");
+		std::string nodeCpuList;
+		if (!std::getline(file, nodeCpuList)) continue;
+		auto nodeCpus = parseCpuList(nodeCpuList);
+		if (!nodeCpus.has_value()) continue;
+		Node node{ id, {}, 0 };
+		std::set_intersection(nodeCpus->begin(), nodeCpus->end(), placement->allCpus.begin(), placement->allCpus.end(), std::back_inserter(node.cpus));
+		if (!node.cpus.empty()) placement->nodes.push_back(std::move(node));
+	}
+	// Systems without NUMA information are treated as a single node
+	if (placement->nodes.empty()) placement->nodes.push_back(Node{ 0, placement->allCpus, 0 });
+	std::sort(placement->nodes.begin(), placement->nodes.end(), [](const Node& a, const Node& b) { return a.id < b.id; });
+	return placement;
+}
+
+int CpuPlacement::assignClient(int socket)
+{
+	int incomingCpu = -1;
+	socklen_t length = sizeof(incomingCpu);
+	if (getsockopt(socket, SOL_SOCKET, SO_INCOMING_CPU, &incomingCpu, &length) != 0) incomingCpu = -1;
+	std::lock_guard lockGuard(mutex);
+	int nodeIndex = incomingCpu >= 0 ? getNodeIndexOfCpu(incomingCpu) : -1;
+	if (nodeIndex >= 0) clientsPlacedByIncomingCpu++;
+	else {
+		// The packets arrive on a CPU we don't use: balance the clients over the nodes
+		auto node = std::min_element(nodes.begin(), nodes.end(), [](const Node& a, const Node& b) { return a.clients < b.clients; });
+		nodeIndex = static_cast<int>(node - nodes.begin());
+	}
+	nodes[nodeIndex].clients++;
+	return nodeIndex;
+}
+
+void CpuPlacement::releaseClient(int nodeIndex)
+{
+	std::lock_guard lockGuard(mutex);
+	if (nodeIndex >= 0 && static_cast<std::size_t>(nodeIndex) < nodes.size() && nodes[nodeIndex].clients > 0) nodes[nodeIndex].clients--;
+}
+
+bool CpuPlacement::pinCurrentThread(int nodeIndex)
+{
+	cpu_set_t cpuSet;
+	CPU_ZERO(&cpuSet);
+	{
+		std::lock_guard lockGuard(mutex);
+		const std::vector<int>& cpus = (nodeIndex >= 0 && static_cast<std::size_t>(nodeIndex) < nodes.size()) ? nodes[nodeIndex].cpus : allCpus;
+		for (int cpu : cpus) CPU_SET(cpu, &cpuSet);
+	}
+	bool success = sched_setaffinity(0, sizeof(cpuSet), &cpuSet) == 0;
+	std::lock_guard lockGuard(mutex);
+	if (success) pinnedThreads++;
+	else failedPins++;
+	return success;
+}
+
+/// Helper function that formats a sorted CPU list in the format parsed by parseCpuList()
+static std::string formatCpuList(const std::vector<int>& cpus)
+{
+	std::string result;
+	for (std::size_t i = 0; i < cpus.size();) {
+		std::size_t j = i;
+		while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) j++;
+		if (!result.empty()) result += ",";
+		result += std::to_string(cpus[i]);
+		if (j > i) result += "-" + std::to_string(cpus[j]);
+		i = j + 1;
+	}
+	return result;
+}
+
+std::string CpuPlacement::getStatistics()
+{
+	std::lock_guard lockGuard(mutex);
+	std::string result = "{\"pinnedThreads\":" + std::to_string(pinnedThreads) + ",\"failedPins\":" + std::to_string(failedPins) +
+		",\"clientsPlacedByIncomingCpu\":" + std::to_string(clientsPlacedByIncomingCpu) + ",\"nodes\":[";
+	for (std::size_t i = 0; i < nodes.size(); ++i) {
+		if (i > 0) result += ",";
+		result += "{\"node\":" + std::to_string(nodes[i].id) + ",\"cpus\":\"" + formatCpuList(nodes[i].cpus) + "\",\"clients\":" + std::to_string(nodes[i].clients) + "}";
+	}
+	result += "]}";
+	return result;
+}
+
+#endif // _LINUX
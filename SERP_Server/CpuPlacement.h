@@ -0,0 +1,68 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <mutex>
+#include <memory>
+#include <optional>
+
+#ifdef _LINUX
+
+/// Parses a CPU list like "0-3,8,10-11" (the format used by /sys and taskset). Returns std::nullopt if the
+/// list is invalid or contains CPUs that don't fit into a cpu_set_t (CPU_SETSIZE).
+std::optional<std::vector<int>> parseCpuList(const std::string& cpuList);
+
+/// This class pins server threads to a configured set of CPUs and places the threads of each client (or the
+/// I/O thread that serves it) on the NUMA node that receives its packets. Memory allocated by a thread after pinning is placed on the
+/// node of the thread by the default first touch policy, st. per-client buffers stay node local.
+class CpuPlacement
+{
+public:
+	/// A NUMA node with the configured CPUs that belong to it
+	struct Node
+	{
+		int id;
+		std::vector<int> cpus;
+		/// Number of clients currently assigned to this node
+		std::size_t clients = 0;
+	};
+private:
+	/// Nodes with at least one configured CPU
+	std::vector<Node> nodes;
+	/// All configured CPUs
+	std::vector<int> allCpus;
+	/// Number of threads that were pinned and number of failed attempts
+	std::size_t pinnedThreads = 0;
+	std::size_t failedPins = 0;
+	/// Number of clients that were assigned by the CPU their packets arrive on (SO_INCOMING_CPU)
+	std::size_t clientsPlacedByIncomingCpu = 0;
+	/// Mutex for thread safe access
+	std::mutex mutex;
+	/// Returns the index of the node the given CPU belongs to, or -1 if it is not configured
+	int getNodeIndexOfCpu(int cpu) const;
+	/// Private constructor, use create()
+	CpuPlacement() = default;
+public:
+	/// Creates a placement for the given CPUs, grouped by the NUMA topology of the system. Returns nullptr
+	/// if the list is invalid or contains no CPU of this system.
+	static std::unique_ptr<CpuPlacement> create(const std::string& cpuList);
+	/// Chooses the node for a newly accepted client. Prefers the node of the CPU that processes the
+	/// packets of the socket (usually the CPU of the IRQ of the NIC queue), else the node with the fewest
+	/// clients. Returns the index of the node.
+	int assignClient(int socket);
+	/// Releases a client assigned by assignClient()
+	void releaseClient(int nodeIndex);
+	/// Returns the number of nodes with at least one configured CPU (does not change after create())
+	std::size_t getNumberOfNodes() const { return nodes.size(); }
+	/// Pins the calling thread to the CPUs of the node with the given index, or to all configured CPUs if
+	/// nodeIndex is -1. Returns false if the affinity could not be set.
+	bool pinCurrentThread(int nodeIndex = -1);
+	/// Returns a JSON object with the configured nodes, the number of clients per node and pinning counters
+	std::string getStatistics();
+	/// Deleted Copy and move constructors and assignment operators
+	CpuPlacement(CpuPlacement& other) = delete;
+	CpuPlacement(CpuPlacement&& other) = delete;
+	CpuPlacement& operator=(CpuPlacement& other) = delete;
+	CpuPlacement& operator=(CpuPlacement&& other) = delete;
+};
+
+#endif // _LINUX
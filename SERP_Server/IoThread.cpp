@@ -0,0 +1,331 @@
+#include "IoThread.h"
+
+#ifdef _IO_URING
+
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <cerrno>
+
+uint64_t IoThread::encodeUserData(Connection* connection, Operation operation, std::size_t index)
+{
+	return reinterpret_cast<uint64_t>(connection) | static_cast<uint64_t>(operation) | (static_cast<uint64_t>(index) << 48);
+}
+
+IoThread::Connection* IoThread::getConnection(uint64_t userData)
+{
+	return reinterpret_cast<Connection*>(userData & ((uint64_t(1) << 48) - 1) & ~uint64_t(7));
+}
+
+IoThread::Operation IoThread::getOperation(uint64_t userData)
+{
+	return static_cast<Operation>(userData & 7);
+}
+
+std::size_t IoThread::getIndex(uint64_t userData)
+{
+	return static_cast<std::size_t>(userData >> 48);
+}
+
+void IoThread::armRead(Connection& connection)
+{
+	ring->preparePoll(connection.socket, POLLRDNORM, encodeUserData(&connection, Operation::READ));
+	connection.readArmed = true;
+	connection.pendingCompletions++;
+}
+
+void IoThread::armWrite(Connection& connection)
+{
+	ring->preparePoll(connection.socket, POLLOUT, encodeUserData(&connection, Operation::WRITE));
+	connection.writeArmed = true;
+	connection.pendingCompletions++;
+}
+
+void IoThread::startBatch(Connection& connection)
+{
+	if (connection.removed || !connection.batch.empty()) return;
+	Client& client = *connection.client;
+	// Reset the flag before we look at the queue, st. messages queued from now on wake us up again
+	client.ioThreadNotified = false;
+	{
+		std::lock_guard lockGuard(client.mutex);
+		while (!client.messagesToBeSent.empty() && connection.batch.size() < maxBatchSize) {
+			connection.batch.push_back(std::move(client.messagesToBeSent.front()));
+			client.messagesToBeSent.pop();
+		}
+	}
+	if (connection.batch.empty()) return;
+	if (connection.broken) {
+		// The socket is broken, the messages can never be sent
+		finishBatch(connection);
+		return;
+	}
+	connection.serializedMessages.reserve(connection.batch.size());
+	for (Client::OutgoingMessage& message : connection.batch) {
+		if (message.serialized) connection.buffers.push_back(std::span<const std::byte>(message.serialized->data(), message.serialized->size()));
+		else {
+			connection.serializedMessages.push_back(message.message->serialize());
+			connection.buffers.push_back(std::span<const std::byte>(connection.serializedMessages.back().data(), connection.serializedMessages.back().size()));
+		}
+	}
+	connection.offsets.assign(connection.buffers.size(), 0);
+	// Hold back partial segments until the whole batch is written
+	if (connection.buffers.size() > 1 && client.shouldCork()) {
+		setSocketCork(client.endpoint.getTCPEndpoint().getSocket(), true);
+		connection.corked = true;
+	}
+	submitSends(connection);
+}
+
+void IoThread::submitSends(Connection& connection)
+{
+	// A chain must not be split by a submission, else it would be linked to the operations of other clients
+	std::size_t count = std::min<std::size_t>(connection.buffers.size() - connection.first, ring->getFreeEntries());
+	if (count == 0) {
+		ring->submit();
+		count = std::min<std::size_t>(connection.buffers.size() - connection.first, ring->getFreeEntries());
+	}
+	std::size_t zeroCopyThreshold = zeroCopySupported && connection.client->zeroCopyEnabled ? connection.client->zeroCopyThreshold : 0;
+	connection.wouldBlock = false;
+	for (std::size_t i = connection.first; i < connection.first + count; ++i) {
+		std::span<const std::byte> buffer = connection.buffers[i].subspan(connection.offsets[i]);
+		// A failed send breaks the chain, the kernel cancels all following sends and we resubmit them
+		ring->prepareSend(connection.socket, buffer, encodeUserData(&connection, Operation::SEND, i),
+			zeroCopyThreshold > 0 && buffer.size() >= zeroCopyThreshold, i + 1 < connection.first + count);
+	}
+	connection.sendsInFlight += static_cast<unsigned>(count);
+	connection.pendingCompletions += static_cast<unsigned>(count);
+}
+
+void IoThread::finishBatch(Connection& connection)
+{
+	if (connection.corked) {
+		setSocketCork(connection.client->endpoint.getTCPEndpoint().getSocket(), false);
+		connection.corked = false;
+	}
+	// Destroying the messages releases their memory charges
+	connection.batch.clear();
+	connection.serializedMessages.clear();
+	connection.buffers.clear();
+	connection.offsets.clear();
+	connection.first = 0;
+	connection.wouldBlock = false;
+}
+
+void IoThread::handleSendCompletion(Connection& connection, const IoUring::Completion& completion)
+{
+	if (completion.flags & IORING_CQE_F_NOTIF) {
+		// The kernel does not need the buffer of a zero copy send anymore
+		connection.sendsInFlight--;
+	}
+	else {
+		// A zero copy send posts a notification later, which takes over the place of the send
+		if (!(completion.flags & IORING_CQE_F_MORE)) connection.sendsInFlight--;
+		else connection.pendingCompletions++;
+		std::size_t index = getIndex(completion.userData);
+		if (completion.result > 0) connection.offsets[index] += static_cast<std::size_t>(completion.result);
+		else if (completion.result == -EAGAIN) connection.wouldBlock = true;
+		else if (completion.result != -ECANCELED) connection.broken = true;
+	}
+	// Wait for the rest of the chain, the buffers must stay alive until then
+	if (connection.sendsInFlight > 0) return;
+	while (connection.first < connection.buffers.size() && connection.offsets[connection.first] == connection.buffers[connection.first].size()) connection.first++;
+	if (connection.removed || connection.broken || connection.first == connection.buffers.size()) {
+		finishBatch(connection);
+		startBatch(connection);
+	}
+	// The socket is non-blocking: wait until there is space in the send buffer again
+	else if (connection.wouldBlock) armWrite(connection);
+	else submitSends(connection);
+}
+
+void IoThread::handleCompletion(const IoUring::Completion& completion)
+{
+	if (getOperation(completion.userData) == Operation::WAKEUP) {
+		uint64_t value = 0;
+		if (read(wakeupFileDescriptor, &value, sizeof(value)) == -1 && errno != EAGAIN) return;
+		ring->preparePoll(wakeupFileDescriptor, POLLIN, encodeUserData(nullptr, Operation::WAKEUP));
+		return;
+	}
+	Connection& connection = *getConnection(completion.userData);
+	connection.pendingCompletions--;
+	switch (getOperation(completion.userData)) {
+	case Operation::READ: {
+		connection.readArmed = false;
+		if (connection.removed) return;
+		// A failed poll operation is treated like an invalid socket
+		unsigned events = completion.result < 0 ? POLLNVAL : static_cast<unsigned>(completion.result);
+		if (!onEvent(*connection.client, events) || connection.removed || !connection.client->connected) return;
+		// Backpressure: leave the data in the socket until the server has memory again (or until the
+		// connection change of the client was made)
+		if (connection.client->isReceivingPaused()) pausedConnections.push_back(&connection);
+		else armRead(connection);
+		return;
+	}
+	case Operation::WRITE:
+		connection.writeArmed = false;
+		if (connection.removed || connection.broken) {
+			finishBatch(connection);
+			return;
+		}
+		submitSends(connection);
+		return;
+	case Operation::SEND:
+		handleSendCompletion(connection, completion);
+		return;
+	default:
+		return;
+	}
+}
+
+void IoThread::removeConnection(Connection& connection)
+{
+	if (connection.removed) return;
+	connection.removed = true;
+	// Armed polls complete with POLLHUP and sends fail, st. nothing waits on the socket anymore
+	shutdown(connection.socket, SHUT_RDWR);
+	std::erase(pausedConnections, &connection);
+}
+
+void IoThread::processRequests()
+{
+	std::vector<std::shared_ptr<Client>> added;
+	std::vector<Client*> removed;
+	std::vector<Client*> withMessages;
+	{
+		std::lock_guard lockGuard(mutex);
+		std::swap(added, addedClients);
+		std::swap(removed, removedClients);
+		std::swap(withMessages, clientsWithMessages);
+	}
+	for (std::shared_ptr<Client>& client : added) {
+		std::unique_ptr<Connection> connection = std::make_unique<Connection>();
+		connection->socket = client->endpoint.getTCPEndpoint().getSocket().sock;
+		connection->client = std::move(client);
+		armRead(*connection);
+		startBatch(*connection);
+		connections.insert(std::make_pair<>(connection->client.get(), std::move(connection)));
+	}
+	for (Client* client : withMessages) {
+		auto connection = connections.find(client);
+		if (connection != connections.end()) startBatch(*connection->second);
+	}
+	for (Client* client : removed) {
+		auto connection = connections.find(client);
+		if (connection != connections.end()) removeConnection(*connection->second);
+	}
+}
+
+void IoThread::run()
+{
+	if (onStart) onStart();
+	ring->preparePoll(wakeupFileDescriptor, POLLIN, encodeUserData(nullptr, Operation::WAKEUP));
+	std::vector<IoUring::Completion> completions;
+	// After we were stopped, we wait until all operations on the sockets completed
+	while (running || !connections.empty()) {
+		completions.clear();
+		int result = ring->submitAndWait(pausedConnections.empty() ? 1000 : static_cast<int>(memoryPauseInterval), completions);
+		if (result < 0 && result != -EBUSY) break;
+		for (const IoUring::Completion& completion : completions) handleCompletion(completion);
+		processRequests();
+		if (!running) {
+			for (auto& connection : connections) removeConnection(*connection.second);
+		}
+		std::vector<Connection*> resumedConnections;
+		std::erase_if(pausedConnections, [&resumedConnections](Connection* connection) {
+			if (connection->client->isReceivingPaused()) return false;
+			resumedConnections.push_back(connection);
+			return true;
+		});
+		for (Connection* connection : resumedConnections) {
+			// Without events, the server only handles the messages it held back while the client was paused
+			if (!onEvent(*connection->client, 0) || connection->removed || !connection->client->connected) continue;
+			if (connection->client->isReceivingPaused()) pausedConnections.push_back(connection);
+			else armRead(*connection);
+		}
+		// Release removed connections that have no operations in flight anymore
+		for (auto it = connections.begin(); it != connections.end();) {
+			if (!it->second->removed || it->second->pendingCompletions > 0) {
+				++it;
+				continue;
+			}
+			finishBatch(*it->second);
+			it->second->client->receiverThreadFinished = true;
+			it = connections.erase(it);
+			{
+				std::lock_guard lockGuard(mutex);
+				numberOfClients--;
+			}
+			clientsReleased.notify_all();
+		}
+	}
+}
+
+IoThread::IoThread(EventCallback onEvent, std::function<void()> onStart, unsigned memoryPauseInterval, int numaNode)
+	: onEvent{ std::move(onEvent) }, onStart{ std::move(onStart) }, memoryPauseInterval{ memoryPauseInterval }, numaNode{ numaNode }
+{
+}
+
+std::unique_ptr<IoThread> IoThread::create(unsigned entries, EventCallback onEvent, std::function<void()> onStart, unsigned memoryPauseInterval, int numaNode)
+{
+	std::unique_ptr<IoThread> ioThread(new IoThread(std::move(onEvent), std::move(onStart), memoryPauseInterval, numaNode));
+	ioThread->ring = IoUring::create(entries);
+	if (!ioThread->ring || !ioThread->ring->supportsOperation(IORING_OP_POLL_ADD) || !ioThread->ring->supportsOperation(IORING_OP_SEND)) return nullptr;
+	ioThread->zeroCopySupported = ioThread->ring->supportsOperation(IORING_OP_SEND_ZC);
+	ioThread->wakeupFileDescriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (ioThread->wakeupFileDescriptor == -1) return nullptr;
+	ioThread->thread = std::thread(&IoThread::run, ioThread.get());
+	return ioThread;
+}
+
+void IoThread::addClient(std::shared_ptr<Client> client)
+{
+	client->ioThread = this;
+	numberOfClients++;
+	{
+		std::lock_guard lockGuard(mutex);
+		addedClients.push_back(std::move(client));
+	}
+	uint64_t value = 1;
+	write(wakeupFileDescriptor, &value, sizeof(value));
+}
+
+void IoThread::removeClient(Client& client)
+{
+	{
+		std::lock_guard lockGuard(mutex);
+		removedClients.push_back(&client);
+	}
+	uint64_t value = 1;
+	write(wakeupFileDescriptor, &value, sizeof(value));
+}
+
+void IoThread::notifyMessages(Client& client)
+{
+	// Only the first message after the thread looked at the queue needs to wake it up
+	if (client.ioThreadNotified.exchange(true)) return;
+	{
+		std::lock_guard lockGuard(mutex);
+		clientsWithMessages.push_back(&client);
+	}
+	uint64_t value = 1;
+	write(wakeupFileDescriptor, &value, sizeof(value));
+}
+
+void IoThread::waitForRemovedClients()
+{
+	std::unique_lock lock(mutex);
+	clientsReleased.wait(lock, [this]() { return numberOfClients == 0; });
+}
+
+IoThread::~IoThread()
+{
+	if (thread.joinable()) {
+		running = false;
+		uint64_t value = 1;
+		write(wakeupFileDescriptor, &value, sizeof(value));
+		thread.join();
+	}
+	if (wakeupFileDescriptor != -1) close(wakeupFileDescriptor);
+}
+
+#endif // _IO_URING
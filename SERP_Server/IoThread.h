@@ -0,0 +1,141 @@
+#pragma once
+#include "Client.h"
+
+#ifdef _IO_URING
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <unordered_map>
+
+/// A thread that serves the sockets of many remote clients with a single io_uring instance (instead of a
+/// sender and a receiver thread per client). The sockets are polled for readability, and the queued
+/// messages of all clients are sent with linked sends, st. one system call submits the work of many
+/// clients. Local clients keep their own threads, because they can switch to the shared memory ring.
+class IoThread
+{
+public:
+	/// Called on the I/O thread when poll reported the given events on the socket of the client. Reads
+	/// the received messages. Is called without events when a paused client is resumed. Returns false if
+	/// the client was disconnected.
+	using EventCallback = std::function<bool(Client&, unsigned events)>;
+private:
+	/// Kinds of operations, stored in the lowest bits of the user data
+	enum class Operation : uint64_t
+	{
+		WAKEUP = 0,
+		READ = 1,
+		WRITE = 2,
+		SEND = 3,
+	};
+	/// Maximal number of messages that are sent as one batch. The index of a message in the batch is
+	/// stored in the highest 16 bits of the user data.
+	static constexpr std::size_t maxBatchSize = 1024;
+	/// State of a client served by this thread. Only accessed by the I/O thread.
+	struct alignas(8) Connection
+	{
+		std::shared_ptr<Client> client;
+		int socket = -1;
+		/// true while a poll for reading/writing is armed
+		bool readArmed = false;
+		bool writeArmed = false;
+		/// true if the client was removed. The connection is released once no operation is in flight anymore.
+		bool removed = false;
+		/// true if a send failed. Queued messages are dropped, the read poll reports the broken socket.
+		bool broken = false;
+		/// true if the socket is corked while the current batch is sent
+		bool corked = false;
+		/// The batch of messages that is being sent, the buffers to send (pointing into the shared serialized
+		/// messages and into serializedMessages) and how many bytes of each buffer were sent
+		std::vector<Client::OutgoingMessage> batch;
+		std::vector<SnackerEngine::Buffer> serializedMessages;
+		std::vector<std::span<const std::byte>> buffers;
+		std::vector<std::size_t> offsets;
+		/// Index of the first buffer that was not sent completely
+		std::size_t first = 0;
+		/// Number of sends (and zero copy notifications) of the current chain that did not complete yet
+		unsigned sendsInFlight = 0;
+		/// true if a send of the current chain found the socket buffer full
+		bool wouldBlock = false;
+		/// Number of completions that are still expected for this connection
+		unsigned pendingCompletions = 0;
+	};
+	/// The ring shared by all clients of this thread, and an eventfd that wakes the thread up
+	std::unique_ptr<IoUring> ring;
+	int wakeupFileDescriptor = -1;
+	/// true if the kernel supports zero copy sends on io_uring
+	bool zeroCopySupported = false;
+	/// Requests from other threads, guarded by mutex
+	std::mutex mutex;
+	std::vector<std::shared_ptr<Client>> addedClients;
+	std::vector<Client*> removedClients;
+	std::vector<Client*> clientsWithMessages;
+	/// Clients served by this thread, and clients whose socket is not read at the moment (see Client::isReceivingPaused)
+	std::unordered_map<Client*, std::unique_ptr<Connection>> connections;
+	std::vector<Connection*> pausedConnections;
+	/// Number of clients served by this thread. clientsReleased is notified (with mutex) when it drops.
+	std::atomic<std::size_t> numberOfClients = 0;
+	std::condition_variable clientsReleased;
+	/// Callbacks for socket events and for the start of the thread (eg. for pinning it)
+	EventCallback onEvent;
+	std::function<void()> onStart;
+	/// Interval in ms in which paused clients are checked
+	unsigned memoryPauseInterval;
+	/// Index of the NUMA node the thread is pinned to (-1 if it is not pinned to a single node)
+	int numaNode;
+	/// The thread itself, and a flag to stop it
+	std::thread thread;
+	std::atomic<bool> running = true;
+	/// Helper functions that encode/decode the user data of an operation
+	static uint64_t encodeUserData(Connection* connection, Operation operation, std::size_t index = 0);
+	static Connection* getConnection(uint64_t userData);
+	static Operation getOperation(uint64_t userData);
+	static std::size_t getIndex(uint64_t userData);
+	/// Helper functions that arm the polls of the given connection
+	void armRead(Connection& connection);
+	void armWrite(Connection& connection);
+	/// Takes the next batch of queued messages of the client, if no batch is being sent
+	void startBatch(Connection& connection);
+	/// Submits linked sends for the unsent part of the current batch
+	void submitSends(Connection& connection);
+	/// Releases the messages of the current batch
+	void finishBatch(Connection& connection);
+	/// Helper functions that handle completions
+	void handleCompletion(const IoUring::Completion& completion);
+	void handleSendCompletion(Connection& connection, const IoUring::Completion& completion);
+	/// Applies the requests of other threads (added/removed clients and clients with new messages)
+	void processRequests();
+	/// Marks the given connection as removed and shuts its socket down, st. all polls and sends complete
+	void removeConnection(Connection& connection);
+	/// Function that is run by the thread
+	void run();
+	/// Private constructor, use create()
+	IoThread(EventCallback onEvent, std::function<void()> onStart, unsigned memoryPauseInterval, int numaNode);
+public:
+	/// Creates and starts a new I/O thread with an io_uring instance of the given number of entries. onStart
+	/// is expected to pin the thread to the given NUMA node. Returns nullptr if io_uring or one of the used
+	/// operations is not supported by the kernel.
+	static std::unique_ptr<IoThread> create(unsigned entries, EventCallback onEvent, std::function<void()> onStart, unsigned memoryPauseInterval, int numaNode = -1);
+	/// Hands a connected client to this thread
+	void addClient(std::shared_ptr<Client> client);
+	/// Removes a disconnected client. Its receiverThreadFinished flag is set once the thread is done with it.
+	void removeClient(Client& client);
+	/// Tells the thread that the client has queued messages
+	void notifyMessages(Client& client);
+	/// Returns the number of clients served by this thread
+	std::size_t getNumberOfClients() const { return numberOfClients; }
+	/// Returns the index of the NUMA node the thread is pinned to, or -1
+	int getNumaNode() const { return numaNode; }
+	/// Blocks until all clients were removed and released. Callbacks are not called anymore from then on.
+	void waitForRemovedClients();
+	/// Destructor, stops the thread
+	~IoThread();
+	/// Deleted Copy and move constructors and assignment operators
+	IoThread(IoThread& other) = delete;
+	IoThread(IoThread&& other) = delete;
+	IoThread& operator=(IoThread& other) = delete;
+	IoThread& operator=(IoThread&& other) = delete;
+};
+
+#endif // _IO_URING
@@ -0,0 +1,165 @@
+#include "IoUring.h"
+
+#ifdef _IO_URING
+
+#include <poll.h>
+#include <cerrno>
+
+bool IoUring::submitMultishotAccept(uint64_t tag)
+{
+	io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+	if (!sqe) return false;
+	io_uring_prep_multishot_accept(sqe, multishotFileDescriptors[tag], nullptr, nullptr, SOCK_CLOEXEC);
+	io_uring_sqe_set_data64(sqe, tag);
+	return io_uring_submit(&ring) == 1;
+}
+
+bool IoUring::waitForCompletion(int timeoutMs, io_uring_cqe& completion, WaitResult& error, int& errorCode)
+{
+	io_uring_cqe* cqe = nullptr;
+	__kernel_timespec timeout{ timeoutMs / 1000, (timeoutMs % 1000) * 1000000LL };
+	int result = timeoutMs == 0 ? io_uring_peek_cqe(&ring, &cqe) : io_uring_wait_cqe_timeout(&ring, &cqe, &timeout);
+	if (result == -ETIME || result == -EAGAIN || result == -EINTR) {
+		error = WaitResult::TIMEOUT;
+		return false;
+	}
+	if (result < 0) {
+		error = WaitResult::ERROR;
+		errorCode = -result;
+		return false;
+	}
+	completion = *cqe;
+	io_uring_cqe_seen(&ring, cqe);
+	return true;
+}
+
+io_uring_sqe* IoUring::getSubmissionQueueEntry()
+{
+	io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+	if (sqe) return sqe;
+	io_uring_submit(&ring);
+	return io_uring_get_sqe(&ring);
+}
+
+std::unique_ptr<IoUring> IoUring::create(unsigned entries)
+{
+	std::unique_ptr<IoUring> result(new IoUring());
+	// Fails with ENOSYS on kernels without io_uring and EPERM if it was disabled by the administrator
+	if (io_uring_queue_init(entries, &result->ring, 0) < 0) return nullptr;
+	result->initialized = true;
+	result->entries = entries;
+	return result;
+}
+
+bool IoUring::supportsOperation(int operation)
+{
+	io_uring_probe* probe = io_uring_get_probe_ring(&ring);
+	if (!probe) return false;
+	bool supported = io_uring_opcode_supported(probe, operation);
+	io_uring_free_probe(probe);
+	return supported;
+}
+
+bool IoUring::armAccept(int fileDescriptor, uint64_t tag)
+{
+	if (multishotFileDescriptors.size() <= tag) multishotFileDescriptors.resize(tag + 1, -1);
+	multishotFileDescriptors[tag] = fileDescriptor;
+	return submitMultishotAccept(tag);
+}
+
+IoUring::WaitResult IoUring::waitForAccept(int timeoutMs, int& clientSocket, uint64_t& tag, int& error)
+{
+	io_uring_cqe completion{};
+	WaitResult waitError{};
+	if (!waitForCompletion(timeoutMs, completion, waitError, error)) return waitError;
+	tag = completion.user_data;
+	// The kernel ends a multishot request on errors or overflow, we have to rearm it
+	if (!(completion.flags & IORING_CQE_F_MORE) && tag < multishotFileDescriptors.size()) {
+		if (!submitMultishotAccept(tag)) {
+			error = EBUSY;
+			return WaitResult::ERROR;
+		}
+	}
+	if (completion.res >= 0) {
+		clientSocket = completion.res;
+		return WaitResult::SUCCESS;
+	}
+	error = -completion.res;
+	switch (error) {
+	case EINVAL:
+	case EOPNOTSUPP:
+		return WaitResult::UNSUPPORTED;
+	// Errors of the connection that was about to be accepted, or temporary lack of resources
+	case ECONNABORTED:
+	case EPROTO:
+	case EPERM:
+	case EINTR:
+	case EAGAIN:
+	case EMFILE:
+	case ENFILE:
+	case ENOBUFS:
+	case ENOMEM:
+	case ENETDOWN:
+	case ENOPROTOOPT:
+	case EHOSTDOWN:
+	case ENONET:
+	case EHOSTUNREACH:
+	case ENETUNREACH:
+		return WaitResult::FAILED;
+	default:
+		return WaitResult::ERROR;
+	}
+}
+
+void IoUring::preparePoll(int fileDescriptor, unsigned events, uint64_t userData)
+{
+	io_uring_sqe* sqe = getSubmissionQueueEntry();
+	io_uring_prep_poll_add(sqe, fileDescriptor, events);
+	io_uring_sqe_set_data64(sqe, userData);
+}
+
+void IoUring::prepareSend(int fileDescriptor, std::span<const std::byte> buffer, uint64_t userData, bool zeroCopy, bool link)
+{
+	io_uring_sqe* sqe = getSubmissionQueueEntry();
+	// With MSG_WAITALL the kernel retries partial sends itself, st. a linked send never starts before the
+	// previous buffer was written completely
+	if (zeroCopy) io_uring_prep_send_zc(sqe, fileDescriptor, buffer.data(), buffer.size(), MSG_NOSIGNAL | MSG_WAITALL, 0);
+	else io_uring_prep_send(sqe, fileDescriptor, buffer.data(), buffer.size(), MSG_NOSIGNAL | MSG_WAITALL);
+	io_uring_sqe_set_data64(sqe, userData);
+	if (link) sqe->flags |= IOSQE_IO_LINK;
+}
+
+unsigned IoUring::getFreeEntries()
+{
+	return io_uring_sq_space_left(&ring);
+}
+
+int IoUring::submit()
+{
+	return io_uring_submit(&ring);
+}
+
+int IoUring::submitAndWait(int timeoutMs, std::vector<Completion>& completions)
+{
+	io_uring_cqe* cqe = nullptr;
+	__kernel_timespec timeout{ timeoutMs / 1000, (timeoutMs % 1000) * 1000000LL };
+	int result = io_uring_submit_and_wait_timeout(&ring, &cqe, 1, &timeout, nullptr);
+	if (result < 0 && result != -ETIME && result != -EINTR) return result;
+	// Collect everything that is available, not only the completion we waited for
+	unsigned head = 0;
+	unsigned count = 0;
+	io_uring_for_each_cqe(&ring, head, cqe) {
+		completions.push_back(Completion{ cqe->user_data, cqe->res, cqe->flags });
+		++count;
+	}
+	io_uring_cq_advance(&ring, count);
+	return 0;
+}
+
+IoUring::~IoUring()
+{
+	if (!initialized) return;
+	io_uring_queue_exit(&ring);
+}
+
+#endif // _IO_URING
@@ -0,0 +1,90 @@
+#pragma once
+#include "Network/SERP/SERPEndpoint.h"
+
+#ifdef _IO_URING
+
+#include <liburing.h>
+#include <vector>
+#include <span>
+#include <memory>
+
+/// Thin wrapper around an io_uring instance, used as optional I/O backend on linux (enabled with the
+/// cmake option SERP_IO_URING). The accepting thread and every I/O thread own one instance each. If
+/// the kernel lacks support for io_uring or one of the used operations, the functions report this and
+/// the caller falls back to the poll() code path.
+class IoUring
+{
+public:
+	/// Result of waiting for a completion
+	enum class WaitResult
+	{
+		/// A connection was accepted
+		SUCCESS,
+		/// Nothing happened (yet)
+		TIMEOUT,
+		/// Accepting this one connection failed (eg. it was aborted or we ran out of file descriptors), the
+		/// listening socket is fine
+		FAILED,
+		/// The kernel does not support the operation, fall back to poll()
+		UNSUPPORTED,
+		/// Any other error
+		ERROR,
+	};
+	/// A completion of an operation prepared with one of the prepare functions
+	struct Completion
+	{
+		uint64_t userData;
+		int result;
+		unsigned flags;
+	};
+private:
+	/// The ring itself and a flag that is set once it was successfully initialized
+	io_uring ring;
+	bool initialized = false;
+	/// Number of submission queue entries
+	unsigned entries = 0;
+	/// File descriptors of armed multishot accepts (indexed by the tag stored in user data)
+	std::vector<int> multishotFileDescriptors;
+	/// Helper function that arms a multishot accept on the given file descriptor
+	bool submitMultishotAccept(uint64_t tag);
+	/// Waits at most timeoutMs for the next completion. Returns false on timeout or error (and sets errorCode).
+	bool waitForCompletion(int timeoutMs, io_uring_cqe& completion, WaitResult& error, int& errorCode);
+	/// Returns a free submission queue entry, submitting the prepared ones first if the queue is full
+	io_uring_sqe* getSubmissionQueueEntry();
+	/// Private constructor, use create()
+	IoUring() = default;
+public:
+	/// Creates a new io_uring instance with the given number of submission queue entries.
+	/// Returns nullptr if the kernel does not support io_uring (or it was disabled).
+	static std::unique_ptr<IoUring> create(unsigned entries);
+	/// Returns true if the kernel supports the given operation (IORING_OP_*)
+	bool supportsOperation(int operation);
+	/// Arms a multishot accept on the given listening socket. The tag is reported with accepted connections.
+	bool armAccept(int fileDescriptor, uint64_t tag);
+	/// Waits for an accepted connection. On SUCCESS, clientSocket and tag are set. On FAILED and ERROR,
+	/// error is set to the errno value.
+	WaitResult waitForAccept(int timeoutMs, int& clientSocket, uint64_t& tag, int& error);
+	/// Prepares a single shot poll for the given events on the given file descriptor
+	void preparePoll(int fileDescriptor, unsigned events, uint64_t userData);
+	/// Prepares a send of the given buffer. If link is true, the next prepared operation only starts once
+	/// this one completed fully, and is cancelled otherwise. Zero copy sends post a second completion
+	/// (with IORING_CQE_F_NOTIF) once the kernel does not need the buffer anymore.
+	void prepareSend(int fileDescriptor, std::span<const std::byte> buffer, uint64_t userData, bool zeroCopy, bool link);
+	/// Returns the number of operations that can still be prepared without a submission in between. Linked
+	/// operations must be prepared without a submission in between.
+	unsigned getFreeEntries();
+	/// Submits all prepared operations
+	int submit();
+	/// Submits all prepared operations and waits at most timeoutMs for at least one completion. All
+	/// available completions are appended to completions. Returns a negative errno value on errors.
+	int submitAndWait(int timeoutMs, std::vector<Completion>& completions);
+	/// Destructor
+	~IoUring();
+	/// Deleted Copy and move constructors and assignment operators
+	IoUring(IoUring& other) = delete;
+	IoUring(IoUring&& other) = delete;
+	IoUring& operator=(IoUring& other) = delete;
+	IoUring& operator=(IoUring&& other) = delete;
+};
+
+#endif // _IO_URING
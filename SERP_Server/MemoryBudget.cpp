@@ -0,0 +1,165 @@
+#include "MemoryBudget.h"
+#include <algorithm>
+
+std::size_t MemoryAccount::getHeldBytes() const
+{
+	return queuedBytes + unsentBytes + zeroCopyBytes;
+}
+
+MemoryCharge::MemoryCharge(MemoryBudget& budget, std::shared_ptr<MemoryAccount> holder, std::shared_ptr<MemoryAccount> sender, std::size_t bytes)
+	: budget{ &budget }, holder{ std::move(holder) }, sender{ std::move(sender) }, bytes{ bytes }
+{
+	if (this->holder) budget.add(this->holder->queuedBytes, bytes);
+	else budget.addUnaccounted(bytes);
+	// The sender is only charged for the messages, the global total already contains them
+	if (this->sender) this->sender->inFlightBytes += bytes;
+}
+
+MemoryCharge::MemoryCharge(MemoryCharge&& other) noexcept
+	: budget{ other.budget }, holder{ std::move(other.holder) }, sender{ std::move(other.sender) }, bytes{ other.bytes }
+{
+	other.budget = nullptr;
+}
+
+MemoryCharge& MemoryCharge::operator=(MemoryCharge&& other) noexcept
+{
+	if (this == &other) return *this;
+	release();
+	budget = other.budget;
+	holder = std::move(other.holder);
+	sender = std::move(other.sender);
+	bytes = other.bytes;
+	other.budget = nullptr;
+	return *this;
+}
+
+void MemoryCharge::release()
+{
+	if (!budget) return;
+	if (holder) budget->remove(holder->queuedBytes, bytes);
+	else budget->removeUnaccounted(bytes);
+	if (sender) sender->inFlightBytes -= bytes;
+	budget = nullptr;
+	holder = nullptr;
+	sender = nullptr;
+}
+
+MemoryCharge::~MemoryCharge()
+{
+	release();
+}
+
+MemoryBudget::MemoryBudget(std::size_t budget)
+	: budget{ 0 }, resumeLimit{ 0 }, shedLimit{ 0 }
+{
+	setBudget(budget);
+}
+
+void MemoryBudget::setBudget(std::size_t budget)
+{
+	this->budget = budget;
+	resumeLimit = budget - budget / 10;
+	shedLimit = budget + budget / 4;
+}
+
+void MemoryBudget::add(std::atomic<std::size_t>& counter, std::size_t bytes)
+{
+	counter += bytes;
+	totalBytes += bytes;
+}
+
+void MemoryBudget::remove(std::atomic<std::size_t>& counter, std::size_t bytes)
+{
+	counter -= bytes;
+	totalBytes -= bytes;
+}
+
+void MemoryBudget::set(std::atomic<std::size_t>& counter, std::size_t bytes)
+{
+	// Each counter is only set by a single thread, the total is adjusted by the difference
+	std::size_t previous = counter.exchange(bytes);
+	if (bytes >= previous) totalBytes += bytes - previous;
+	else totalBytes -= previous - bytes;
+}
+
+void MemoryBudget::addUnaccounted(std::size_t bytes)
+{
+	totalBytes += bytes;
+}
+
+void MemoryBudget::removeUnaccounted(std::size_t bytes)
+{
+	totalBytes -= bytes;
+}
+
+std::optional<SnackerEngine::SERPID> MemoryBudget::enforce(const std::vector<std::pair<SnackerEngine::SERPID, std::shared_ptr<MemoryAccount>>>& accounts)
+{
+	if (budget == 0) return {};
+	std::size_t total = totalBytes;
+	if (total <= resumeLimit) {
+		for (auto& account : accounts) account.second->paused = false;
+		return {};
+	}
+	if (total > budget) {
+		// Pause the heaviest senders until the bytes they have in flight cover the excess. The counters change
+		// while the other threads run, the senders are sorted by a snapshot taken once.
+		std::vector<std::pair<std::size_t, MemoryAccount*>> senders;
+		senders.reserve(accounts.size());
+		std::size_t pausedBytes = 0;
+		for (auto& account : accounts) {
+			std::size_t inFlightBytes = account.second->inFlightBytes;
+			if (account.second->paused) pausedBytes += inFlightBytes;
+			else if (inFlightBytes > 0) senders.emplace_back(inFlightBytes, account.second.get());
+		}
+		std::sort(senders.begin(), senders.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+		for (auto& [inFlightBytes, sender] : senders) {
+			if (pausedBytes >= total - resumeLimit) break;
+			pausedBytes += inFlightBytes;
+			sender->paused = true;
+			pauses++;
+		}
+	}
+	if (total > shedLimit && !accounts.empty()) {
+		// Backpressure did not help. The memory is held for clients that don't read, shed the largest one.
+		auto heaviest = std::max_element(accounts.begin(), accounts.end(), [](const auto& a, const auto& b) { return a.second->getHeldBytes() < b.second->getHeldBytes(); });
+		if (heaviest->second->getHeldBytes() > 0) {
+			shedClients++;
+			return heaviest->first;
+		}
+	}
+	return {};
+}
+
+std::string MemoryBudget::getStatistics(const std::vector<std::pair<SnackerEngine::SERPID, std::shared_ptr<MemoryAccount>>>& accounts) const
+{
+	std::string result = "{\"totalBytes\":" + std::to_string(totalBytes.load()) + ",\"budget\":" + std::to_string(budget) +
+		",\"pauses\":" + std::to_string(pauses.load()) + ",\"shedClients\":" + std::to_string(shedClients.load()) + ",\"clients\":[";
+	bool first = true;
+	for (auto& [serpID, account] : accounts) {
+		if (!first) result += ",";
+		first = false;
+		result += "{\"serpID\":" + std::to_string(static_cast<unsigned>(serpID)) +
+			",\"queued\":" + std::to_string(account->queuedBytes.load()) +
+			",\"unsent\":" + std::to_string(account->unsentBytes.load()) +
+			",\"zeroCopy\":" + std::to_string(account->zeroCopyBytes.load()) +
+			",\"inFlight\":" + std::to_string(account->inFlightBytes.load()) +
+			",\"paused\":" + std::string(account->paused ? "true" : "false") + "}";
+	}
+	result += "]}";
+	return result;
+}
+
+std::size_t MemoryBudget::getMessageSize(const SnackerEngine::SERPMessage& message)
+{
+	std::size_t size = message.content.size();
+	if (message.isRequest()) {
+		const std::string& target = static_cast<const SnackerEngine::SERPRequest&>(message).target;
+		size += sizeof(SnackerEngine::SERPRequest);
+		// Short targets are stored in the string object itself
+		if (target.capacity() > std::string().capacity()) size += target.capacity() + 1;
+	}
+	else size += sizeof(SnackerEngine::SERPResponse);
+	// Each destination is a node of a hash set and takes a bucket
+	size += message.getDestinations().size() * (sizeof(uint16_t) + 2 * sizeof(void*));
+	return size;
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include "Network/SERP/SERPEndpoint.h"
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <vector>
+#include <string>
+
+/// Memory held on behalf of a single client, in bytes
+struct MemoryAccount
+{
+	/// Messages in the send queue of the client
+	std::atomic<std::size_t> queuedBytes = 0;
+	/// Messages that were handed to the endpoint of the client but not sent completely. The receive buffer of
+	/// the endpoint is not accounted, its size is not visible to the server.
+	std::atomic<std::size_t> unsentBytes = 0;
+	/// Buffers that are pinned by zero copy sends
+	std::atomic<std::size_t> zeroCopyBytes = 0;
+	/// Messages sent by this client that wait in the send queues of other clients
+	std::atomic<std::size_t> inFlightBytes = 0;
+	/// true while the server does not read from this client
+	std::atomic<bool> paused = false;
+	/// Returns the number of bytes held by the server for this client
+	std::size_t getHeldBytes() const;
+};
+
+class MemoryBudget;
+
+/// Bytes charged to the memory budget for a queued message. The charge is released on destruction.
+class MemoryCharge
+{
+	MemoryBudget* budget = nullptr;
+	/// Account whose queue holds the message and account of the client that sent it (both optional)
+	std::shared_ptr<MemoryAccount> holder;
+	std::shared_ptr<MemoryAccount> sender;
+	std::size_t bytes = 0;
+public:
+	MemoryCharge() = default;
+	MemoryCharge(MemoryBudget& budget, std::shared_ptr<MemoryAccount> holder, std::shared_ptr<MemoryAccount> sender, std::size_t bytes);
+	MemoryCharge(MemoryCharge&& other) noexcept;
+	MemoryCharge& operator=(MemoryCharge&& other) noexcept;
+	/// Releases the charge early
+	void release();
+	~MemoryCharge();
+	MemoryCharge(const MemoryCharge& other) = delete;
+	MemoryCharge& operator=(const MemoryCharge& other) = delete;
+};
+
+/// A serialized message that is shared by several send queues and charged once
+struct ChargedBuffer
+{
+	SnackerEngine::Buffer buffer;
+	MemoryCharge charge;
+};
+
+/// This class keeps track of the memory the server holds for all clients and enforces a global budget.
+/// If the budget is exceeded, the server stops reading from the clients with the most bytes in flight
+/// (backpressure). If that does not help and the memory grows beyond the shedding limit, the memory is
+/// held by clients that don't read their messages, and the one holding the most is disconnected.
+class MemoryBudget
+{
+	/// Bytes held for all clients
+	std::atomic<std::size_t> totalBytes = 0;
+	/// Budget in bytes (0 only accounts memory), the limit below which reading is resumed and the limit
+	/// above which clients are disconnected
+	std::size_t budget;
+	std::size_t resumeLimit;
+	std::size_t shedLimit;
+	/// Number of times a client was paused and number of disconnected clients
+	std::atomic<uint64_t> pauses = 0;
+	std::atomic<uint64_t> shedClients = 0;
+public:
+	/// Constructor. A budget of 0 disables enforcing.
+	MemoryBudget(std::size_t budget = 0);
+	/// Sets the budget in bytes (0 disables enforcing). Not thread safe, must be called before clients connect.
+	void setBudget(std::size_t budget);
+	/// Adds/removes bytes to/from the given counter of an account
+	void add(std::atomic<std::size_t>& counter, std::size_t bytes);
+	void remove(std::atomic<std::size_t>& counter, std::size_t bytes);
+	/// Sets the given counter of an account to the given value
+	void set(std::atomic<std::size_t>& counter, std::size_t bytes);
+	/// Adds/removes bytes that belong to no account
+	void addUnaccounted(std::size_t bytes);
+	void removeUnaccounted(std::size_t bytes);
+	/// Returns true if a budget is enforced
+	bool isEnforced() const { return budget > 0; }
+	/// Pauses and resumes reading from the given clients as necessary. Returns the client that should
+	/// be disconnected to shed load, if any.
+	std::optional<SnackerEngine::SERPID> enforce(const std::vector<std::pair<SnackerEngine::SERPID, std::shared_ptr<MemoryAccount>>>& accounts);
+	/// Returns a JSON object with the total, the budget and the accounts of the given clients
+	std::string getStatistics(const std::vector<std::pair<SnackerEngine::SERPID, std::shared_ptr<MemoryAccount>>>& accounts) const;
+	/// Returns the memory that is accounted for the given message: the message object, its body, the target
+	/// of a request and the destinations of a multi send. Allocator overhead and unused capacity of the body
+	/// are not visible and not counted, so the result is a lower bound.
+	static std::size_t getMessageSize(const SnackerEngine::SERPMessage& message);
+};
@@ -0,0 +1,211 @@
+#include "MessageStore.h"
+#include "Utility/Formatting.h"
+
+#ifdef _LINUX
+
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+
+namespace
+{
+	/// Records are padded to 8 bytes st. record headers are always aligned
+	uint64_t alignRecord(uint64_t size)
+	{
+		return (size + 7) & ~uint64_t(7);
+	}
+}
+
+std::unique_ptr<MessageStoreSegment> MessageStoreSegment::create(const std::filesystem::path& path, std::size_t capacity)
+{
+	int fd = open(path.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0600);
+	if (fd == -1) return nullptr;
+	if (ftruncate(fd, static_cast<off_t>(capacity)) == -1) {
+		close(fd);
+		unlink(path.c_str());
+		return nullptr;
+	}
+	void* mapping = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		unlink(path.c_str());
+		return nullptr;
+	}
+	std::unique_ptr<MessageStoreSegment> segment(new MessageStoreSegment());
+	segment->path = path;
+	segment->mapping = static_cast<std::byte*>(mapping);
+	segment->capacity = capacity;
+	MessageStoreSegmentHeader* header = reinterpret_cast<MessageStoreSegmentHeader*>(segment->mapping);
+	header->magic = magic;
+	header->version = version;
+	header->writeOffset = sizeof(MessageStoreSegmentHeader);
+	header->newestExpiry = 0;
+	return segment;
+}
+
+bool MessageStoreSegment::append(const std::byte* data, uint32_t size, int64_t expiry)
+{
+	MessageStoreSegmentHeader* header = reinterpret_cast<MessageStoreSegmentHeader*>(mapping);
+	uint64_t recordSize = alignRecord(sizeof(MessageStoreRecordHeader) + size);
+	if (header->writeOffset + recordSize > capacity) return false;
+	MessageStoreRecordHeader recordHeader{ size, 0, expiry };
+	std::memcpy(mapping + header->writeOffset, &recordHeader, sizeof(recordHeader));
+	std::memcpy(mapping + header->writeOffset + sizeof(recordHeader), data, size);
+	header->writeOffset += recordSize;
+	header->newestExpiry = std::max(header->newestExpiry, expiry);
+	return true;
+}
+
+void MessageStoreSegment::readMessages(int64_t now, std::vector<std::unique_ptr<SnackerEngine::SERPMessage>>& messages) const
+{
+	const MessageStoreSegmentHeader* header = reinterpret_cast<const MessageStoreSegmentHeader*>(mapping);
+	// We read the segment front to back exactly once
+	madvise(mapping, header->writeOffset, MADV_SEQUENTIAL);
+	madvise(mapping, header->writeOffset, MADV_WILLNEED);
+	uint64_t offset = sizeof(MessageStoreSegmentHeader);
+	while (offset + sizeof(MessageStoreRecordHeader) <= header->writeOffset) {
+		MessageStoreRecordHeader recordHeader;
+		std::memcpy(&recordHeader, mapping + offset, sizeof(recordHeader));
+		if (recordHeader.expiry > now) {
+			std::unique_ptr<SnackerEngine::SERPMessage> message = SnackerEngine::SERPMessage::parse(
+				SnackerEngine::ConstantBufferView(mapping + offset + sizeof(recordHeader), recordHeader.size));
+			if (message) messages.push_back(std::move(message));
+		}
+		offset += alignRecord(sizeof(MessageStoreRecordHeader) + recordHeader.size);
+	}
+}
+
+uint64_t MessageStoreSegment::getUsedBytes() const
+{
+	return reinterpret_cast<const MessageStoreSegmentHeader*>(mapping)->writeOffset;
+}
+
+int64_t MessageStoreSegment::getNewestExpiry() const
+{
+	return reinterpret_cast<const MessageStoreSegmentHeader*>(mapping)->newestExpiry;
+}
+
+void MessageStoreSegment::remove()
+{
+	if (mapping) munmap(mapping, capacity);
+	mapping = nullptr;
+	unlink(path.c_str());
+}
+
+MessageStoreSegment::~MessageStoreSegment()
+{
+	if (mapping) munmap(mapping, capacity);
+}
+
+int64_t MessageStore::now()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void MessageStore::removeOldestSegment(Log& log)
+{
+	totalUsedBytes -= log.segments.front()->getUsedBytes();
+	log.usedBytes -= log.segments.front()->getUsedBytes();
+	numberOfSegments--;
+	log.segments.front()->remove();
+	log.segments.erase(log.segments.begin());
+}
+
+MessageStore::MessageStore(const std::filesystem::path& directory, std::size_t segmentSize, std::size_t maxBytesPerClient,
+	std::size_t maxTotalBytes, std::size_t maxSegments, std::chrono::milliseconds timeToLive)
+	: directory{ directory }, segmentSize{ segmentSize }, maxBytesPerClient{ maxBytesPerClient }, maxTotalBytes{ maxTotalBytes },
+	maxSegments{ maxSegments }, timeToLive{ timeToLive }, logs{}, mutex{}
+{
+}
+
+bool MessageStore::store(SnackerEngine::SERPID destination, SnackerEngine::SERPMessage& message)
+{
+	SnackerEngine::Buffer serialized = message.serialize();
+	uint64_t recordSize = alignRecord(sizeof(MessageStoreRecordHeader) + serialized.size());
+	if (recordSize + sizeof(MessageStoreSegmentHeader) > segmentSize) return false;
+	int64_t expiry = now() + timeToLive.count();
+	std::lock_guard lockGuard(mutex);
+	if (totalUsedBytes + recordSize > maxTotalBytes) return false;
+	Log& log = logs[static_cast<unsigned>(destination)];
+	if (log.usedBytes + recordSize > maxBytesPerClient) {
+		if (log.segments.empty()) logs.erase(static_cast<unsigned>(destination));
+		return false;
+	}
+	if (!log.segments.empty() && log.segments.back()->append(serialized.data(), static_cast<uint32_t>(serialized.size()), expiry)) {
+		log.usedBytes += recordSize;
+		totalUsedBytes += recordSize;
+		return true;
+	}
+	// Start a new segment
+	std::unique_ptr<MessageStoreSegment> segment = nullptr;
+	if (numberOfSegments < maxSegments) {
+		// Only the user of the server may read stored messages
+		std::error_code errorCode;
+		if (std::filesystem::create_directories(directory, errorCode)) {
+			std::filesystem::permissions(directory, std::filesystem::perms::owner_all, errorCode);
+			createdDirectory = true;
+		}
+		// The pid keeps the names apart from segments a previous run left behind
+		std::filesystem::path path = directory / (std::to_string(getpid()) + "_" + SnackerEngine::to_string(destination) + "_" + std::to_string(segmentCounter++) + ".log");
+		segment = MessageStoreSegment::create(path, segmentSize);
+	}
+	if (!segment || !segment->append(serialized.data(), static_cast<uint32_t>(serialized.size()), expiry)) {
+		if (segment) segment->remove();
+		if (log.segments.empty()) logs.erase(static_cast<unsigned>(destination));
+		return false;
+	}
+	// The header of a new segment counts as used as well
+	log.usedBytes += segment->getUsedBytes();
+	totalUsedBytes += segment->getUsedBytes();
+	numberOfSegments++;
+	log.segments.push_back(std::move(segment));
+	return true;
+}
+
+std::vector<std::unique_ptr<SnackerEngine::SERPMessage>> MessageStore::takeMessages(SnackerEngine::SERPID destination)
+{
+	Log log;
+	{
+		std::lock_guard lockGuard(mutex);
+		auto it = logs.find(static_cast<unsigned>(destination));
+		if (it == logs.end()) return {};
+		log = std::move(it->second);
+		logs.erase(it);
+		totalUsedBytes -= log.usedBytes;
+		numberOfSegments -= log.segments.size();
+	}
+	// Read without holding the lock, the segments belong to us now
+	std::vector<std::unique_ptr<SnackerEngine::SERPMessage>> messages;
+	int64_t currentTime = now();
+	for (auto& segment : log.segments) {
+		segment->readMessages(currentTime, messages);
+		segment->remove();
+	}
+	return messages;
+}
+
+void MessageStore::removeExpired()
+{
+	int64_t currentTime = now();
+	std::lock_guard lockGuard(mutex);
+	for (auto it = logs.begin(); it != logs.end();) {
+		Log& log = it->second;
+		// Segments are ordered by age, so we can stop at the first segment that is still alive
+		while (!log.segments.empty() && log.segments.front()->getNewestExpiry() <= currentTime) removeOldestSegment(log);
+		if (log.segments.empty()) it = logs.erase(it);
+		else ++it;
+	}
+}
+
+MessageStore::~MessageStore()
+{
+	for (auto& log : logs) {
+		for (auto& segment : log.second.segments) segment->remove();
+	}
+	// Only removes the directory if nothing else is in it
+	std::error_code errorCode;
+	if (createdDirectory) std::filesystem::remove(directory, errorCode);
+}
+
+#endif // _LINUX
@@ -0,0 +1,132 @@
+#pragma once
+#include "Network/SERP/SERPEndpoint.h"
+#include <filesystem>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+
+#ifdef _LINUX
+
+/// Header at the beginning of each segment file
+struct MessageStoreSegmentHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	/// Offset (from the beginning of the file) where the next record is written
+	uint64_t writeOffset;
+	/// Expiry time (ms of the steady clock) of the newest record. The whole segment can be deleted afterwards.
+	int64_t newestExpiry;
+};
+
+/// Header in front of each stored message
+struct MessageStoreRecordHeader
+{
+	uint32_t size;
+	uint32_t reserved;
+	/// Expiry time in ms of the steady clock
+	int64_t expiry;
+};
+
+/// A single append-only, memory-mapped segment file of the message store
+class MessageStoreSegment
+{
+	/// Path to the segment file
+	std::filesystem::path path;
+	/// Mapping of the whole file
+	std::byte* mapping = nullptr;
+	std::size_t capacity = 0;
+	/// Private constructor, use create()
+	MessageStoreSegment() = default;
+public:
+	static constexpr uint32_t magic = 0x53455253; // "SERS"
+	static constexpr uint32_t version = 1;
+	/// Creates a new segment file of the given size at the given path. Fails if the file exists already.
+	static std::unique_ptr<MessageStoreSegment> create(const std::filesystem::path& path, std::size_t capacity);
+	/// Appends a record to the segment. Returns false if the segment is full.
+	bool append(const std::byte* data, uint32_t size, int64_t expiry);
+	/// Reads all records that have not yet expired and parses them to messages
+	void readMessages(int64_t now, std::vector<std::unique_ptr<SnackerEngine::SERPMessage>>& messages) const;
+	/// Returns the number of bytes used in this segment
+	uint64_t getUsedBytes() const;
+	/// Returns the expiry time of the newest record
+	int64_t getNewestExpiry() const;
+	/// Unmaps and deletes the segment file
+	void remove();
+	/// Destructor
+	~MessageStoreSegment();
+	/// Deleted Copy and move constructors and assignment operators
+	MessageStoreSegment(MessageStoreSegment& other) = delete;
+	MessageStoreSegment(MessageStoreSegment&& other) = delete;
+	MessageStoreSegment& operator=(MessageStoreSegment& other) = delete;
+	MessageStoreSegment& operator=(MessageStoreSegment&& other) = delete;
+};
+
+/// Store for requests whose destination is currently not connected (store-and-forward). Each SERPID
+/// has its own log of memory-mapped segment files that are only ever appended to. Nothing is synced
+/// to disk explicitly, the page cache writes the segments back in the background. When the SERPID
+/// is reclaimed, the whole log is read sequentially and deleted. The store only ever deletes segment
+/// files it created itself, other files in the directory are left alone.
+/// The store does not survive a restart of the server: the segment files only keep the stored messages
+/// out of the heap. Stored messages can only be taken by a client that reclaims its SERPID with a session
+/// token, and sessions are held in memory, so nobody could read the messages of a previous run anyway.
+/// Expiry times are taken from the steady clock, which has no meaning across restarts either.
+class MessageStore
+{
+private:
+	/// Stored messages of a single SERPID
+	struct Log
+	{
+		/// Segments, oldest first. The last segment is the one that is appended to.
+		std::vector<std::unique_ptr<MessageStoreSegment>> segments;
+		/// Number of bytes used in all segments
+		uint64_t usedBytes = 0;
+	};
+	/// Directory containing the segment files. Is created with the first segment, and only removed again
+	/// if the store created it.
+	std::filesystem::path directory;
+	bool createdDirectory = false;
+	/// Size of a single segment file in bytes
+	std::size_t segmentSize;
+	/// Maximum number of bytes stored for a single SERPID
+	std::size_t maxBytesPerClient;
+	/// Maximum number of bytes stored and of segment files for all SERPIDs together
+	std::size_t maxTotalBytes;
+	std::size_t maxSegments;
+	/// Time after which stored messages are discarded
+	std::chrono::milliseconds timeToLive;
+	/// Logs by SERPID
+	std::unordered_map<unsigned, Log> logs;
+	/// Number of bytes used and number of segment files for all SERPIDs together
+	uint64_t totalUsedBytes = 0;
+	std::size_t numberOfSegments = 0;
+	/// Counter for generating unique segment file names
+	uint64_t segmentCounter = 0;
+	/// Mutex for thread safe access
+	std::mutex mutex;
+	/// Returns the current time in ms (steady clock)
+	static int64_t now();
+	/// Helper function that deletes the oldest segment of the given log
+	void removeOldestSegment(Log& log);
+public:
+	/// Constructor. Does not touch the file system, the directory is only created when the first message is stored.
+	MessageStore(const std::filesystem::path& directory, std::size_t segmentSize, std::size_t maxBytesPerClient,
+		std::size_t maxTotalBytes, std::size_t maxSegments, std::chrono::milliseconds timeToLive);
+	/// Stores the given message for the given destination. Returns false if the message could not be
+	/// stored (too large, or the storage limit for the destination or for the whole store was reached).
+	bool store(SnackerEngine::SERPID destination, SnackerEngine::SERPMessage& message);
+	/// Removes and returns all stored messages (that have not yet expired) for the given destination
+	std::vector<std::unique_ptr<SnackerEngine::SERPMessage>> takeMessages(SnackerEngine::SERPID destination);
+	/// Deletes all segments that only contain expired messages
+	void removeExpired();
+	/// Returns the time to live of stored messages
+	std::chrono::milliseconds getTimeToLive() const { return timeToLive; }
+	/// Destructor, deletes all remaining segment files (and the directory, if the store created it and it is empty)
+	~MessageStore();
+	/// Deleted Copy and move constructors and assignment operators
+	MessageStore(MessageStore& other) = delete;
+	MessageStore(MessageStore&& other) = delete;
+	MessageStore& operator=(MessageStore& other) = delete;
+	MessageStore& operator=(MessageStore&& other) = delete;
+};
+
+#endif // _LINUX
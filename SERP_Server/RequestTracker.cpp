@@ -0,0 +1,209 @@
+#include "RequestTracker.h"
+#include <bit>
+
+void LatencyHistogram::add(std::chrono::microseconds latency)
+{
+	uint64_t microseconds = static_cast<uint64_t>(std::max<int64_t>(latency.count(), 1));
+	std::size_t bucket = std::min<std::size_t>(std::bit_width(microseconds) - 1, numberOfBuckets - 1);
+	buckets[bucket]++;
+	count++;
+	sumMicroseconds += microseconds;
+}
+
+uint64_t LatencyHistogram::quantile(double q) const
+{
+	if (count == 0) return 0;
+	uint64_t target = static_cast<uint64_t>(q * static_cast<double>(count));
+	uint64_t seen = 0;
+	for (std::size_t i = 0; i < numberOfBuckets; ++i) {
+		seen += buckets[i];
+		if (seen > target) return uint64_t(1) << (i + 1);
+	}
+	return uint64_t(1) << numberOfBuckets;
+}
+
+int64_t RequestTracker::now() const
+{
+	// Never return 0, it marks empty slots
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count() + 1;
+}
+
+std::size_t RequestTracker::hash(uint16_t source, uint16_t destination, uint32_t sequenceNumber) const
+{
+	uint64_t key = (uint64_t(source) << 48) | (uint64_t(destination) << 32) | sequenceNumber;
+	// Fibonacci hashing, the table size is a power of two
+	return static_cast<std::size_t>((key * 0x9E3779B97F4A7C15ull) >> (64 - std::countr_zero(table.size())));
+}
+
+RequestTracker::DeadlineList& RequestTracker::getList(const Entry& entry)
+{
+	return entry.timedOut ? timedOutRequests : waitingRequests;
+}
+
+void RequestTracker::append(DeadlineList& list, std::size_t index)
+{
+	table[index].previous = list.last;
+	table[index].next = noSlot;
+	if (list.last != noSlot) table[list.last].next = static_cast<uint32_t>(index);
+	else list.first = static_cast<uint32_t>(index);
+	list.last = static_cast<uint32_t>(index);
+}
+
+void RequestTracker::unlink(DeadlineList& list, std::size_t index)
+{
+	const Entry& entry = table[index];
+	if (entry.previous != noSlot) table[entry.previous].next = entry.next;
+	else list.first = entry.next;
+	if (entry.next != noSlot) table[entry.next].previous = entry.previous;
+	else list.last = entry.previous;
+}
+
+std::size_t RequestTracker::find(uint16_t source, uint16_t destination, uint32_t sequenceNumber) const
+{
+	std::size_t mask = table.size() - 1;
+	std::size_t index = hash(source, destination, sequenceNumber);
+	while (table[index].deadline != emptySlot) {
+		const Entry& entry = table[index];
+		if (entry.source == source && entry.destination == destination && entry.sequenceNumber == sequenceNumber) return index;
+		index = (index + 1) & mask;
+	}
+	return noSlot;
+}
+
+void RequestTracker::erase(std::size_t index)
+{
+	unlink(getList(table[index]), index);
+	numberOfOccupiedSlots--;
+	// Move following entries of the cluster back into the hole if that does not put them before their
+	// home slot, st. every entry stays reachable from its home slot without tombstones
+	std::size_t mask = table.size() - 1;
+	std::size_t hole = index;
+	for (std::size_t current = (hole + 1) & mask; table[current].deadline != emptySlot; current = (current + 1) & mask) {
+		std::size_t home = hash(table[current].source, table[current].destination, table[current].sequenceNumber);
+		if (((current - home) & mask) < ((current - hole) & mask)) continue;
+		Entry& entry = table[hole];
+		entry = table[current];
+		DeadlineList& list = getList(entry);
+		if (entry.previous != noSlot) table[entry.previous].next = static_cast<uint32_t>(hole);
+		else list.first = static_cast<uint32_t>(hole);
+		if (entry.next != noSlot) table[entry.next].previous = static_cast<uint32_t>(hole);
+		else list.last = static_cast<uint32_t>(hole);
+		hole = current;
+	}
+	table[hole].deadline = emptySlot;
+}
+
+RequestTracker::RequestTracker(std::size_t capacity, std::chrono::milliseconds timeout)
+	: table(std::bit_ceil(std::max<std::size_t>(capacity, 2)), Entry{ emptySlot, 0, 0, 0, 0, false, noSlot, noSlot }), timeout{ timeout },
+	gracePeriod{ 10 * timeout }, pairs{}, startTime{ std::chrono::steady_clock::now() }, histograms{}, mutex{}
+{
+}
+
+void RequestTracker::track(SnackerEngine::SERPID source, SnackerEngine::SERPID destination)
+{
+	uint16_t sourceID = static_cast<uint16_t>(static_cast<unsigned>(source));
+	uint16_t destinationID = static_cast<uint16_t>(static_cast<unsigned>(destination));
+	std::lock_guard lockGuard(mutex);
+	// The time is taken with the lock held, st. the deadlines are appended to the list in order
+	int64_t currentTime = now();
+	// The sequence number is used up even if the request can't be tracked, st. the following responses
+	// are still matched to the right requests
+	uint32_t sequenceNumber = pairs[(uint32_t(sourceID) << 16) | destinationID].nextRequest++;
+	// Keep the load factor below 3/4, else probe sequences get long
+	if ((numberOfOccupiedSlots + 1) * 4 > table.size() * 3) {
+		untrackedRequests++;
+		return;
+	}
+	std::size_t mask = table.size() - 1;
+	std::size_t index = hash(sourceID, destinationID, sequenceNumber);
+	// Sequence numbers are unique, so we take the first free slot
+	while (table[index].deadline != emptySlot) index = (index + 1) & mask;
+	numberOfOccupiedSlots++;
+	table[index] = Entry{ currentTime + std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count(), currentTime, sequenceNumber, sourceID, destinationID, false, noSlot, noSlot };
+	append(waitingRequests, index);
+}
+
+void RequestTracker::countUntracked(SnackerEngine::SERPID source, const std::vector<SnackerEngine::SERPID>& destinations)
+{
+	uint32_t sourceID = static_cast<uint16_t>(static_cast<unsigned>(source));
+	std::lock_guard lockGuard(mutex);
+	for (SnackerEngine::SERPID destination : destinations) {
+		pairs[(sourceID << 16) | static_cast<uint16_t>(static_cast<unsigned>(destination))].nextRequest++;
+	}
+}
+
+RequestTracker::Completion RequestTracker::complete(SnackerEngine::SERPID source, SnackerEngine::SERPID destination)
+{
+	uint16_t sourceID = static_cast<uint16_t>(static_cast<unsigned>(source));
+	uint16_t destinationID = static_cast<uint16_t>(static_cast<unsigned>(destination));
+	int64_t currentTime = now();
+	std::lock_guard lockGuard(mutex);
+	auto pair = pairs.find((uint32_t(sourceID) << 16) | destinationID);
+	// More responses than requests: the request was relayed before tracking started, or the pair was forgotten
+	if (pair == pairs.end() || pair->second.nextResponse == pair->second.nextRequest) return Completion::UNTRACKED;
+	// The sequence number of an untracked request is not in the table, its response completes nothing
+	std::size_t index = find(sourceID, destinationID, pair->second.nextResponse++);
+	if (index == noSlot) return Completion::UNTRACKED;
+	bool timedOut = table[index].timedOut;
+	if (!timedOut) histograms[destinationID].add(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::nanoseconds(currentTime - table[index].relayTime)));
+	erase(index);
+	return timedOut ? Completion::LATE : Completion::COMPLETED;
+}
+
+std::vector<RequestTracker::Entry> RequestTracker::collectExpired()
+{
+	std::vector<Entry> expired;
+	std::lock_guard lockGuard(mutex);
+	int64_t currentTime = now();
+	int64_t gracePeriodEnd = currentTime + std::chrono::duration_cast<std::chrono::nanoseconds>(gracePeriod).count();
+	// Both lists are ordered by deadline, we stop at the first entry that is still alive
+	while (timedOutRequests.first != noSlot && table[timedOutRequests.first].deadline <= currentTime) {
+		// The grace period is over, a response arriving now is relayed as untracked
+		erase(timedOutRequests.first);
+	}
+	while (waitingRequests.first != noSlot && table[waitingRequests.first].deadline <= currentTime) {
+		std::size_t index = waitingRequests.first;
+		Entry& entry = table[index];
+		expired.push_back(entry);
+		histograms[entry.destination].timeouts++;
+		unlink(waitingRequests, index);
+		entry.timedOut = true;
+		entry.deadline = gracePeriodEnd;
+		append(timedOutRequests, index);
+	}
+	return expired;
+}
+
+void RequestTracker::removeClient(SnackerEngine::SERPID serpID)
+{
+	uint16_t id = static_cast<uint16_t>(static_cast<unsigned>(serpID));
+	std::lock_guard lockGuard(mutex);
+	histograms.erase(id);
+	std::erase_if(pairs, [id](const auto& pair) { return (pair.first >> 16) == id || (pair.first & 0xFFFF) == id; });
+	// A new client with the same SERPID starts with new sequence numbers, which must not match old entries.
+	// Erasing moves entries around, so we collect the entries first and look each one up again.
+	std::vector<Entry> removedEntries;
+	for (const Entry& entry : table) {
+		if (entry.deadline != emptySlot && (entry.source == id || entry.destination == id)) removedEntries.push_back(entry);
+	}
+	for (const Entry& entry : removedEntries) erase(find(entry.source, entry.destination, entry.sequenceNumber));
+}
+
+std::string RequestTracker::getStatistics()
+{
+	std::lock_guard lockGuard(mutex);
+	std::string result = "{\"inFlight\":" + std::to_string(numberOfOccupiedSlots) + ",\"untracked\":" + std::to_string(untrackedRequests) + ",\"destinations\":[";
+	bool first = true;
+	for (const auto& [serpID, histogram] : histograms) {
+		if (!first) result += ",";
+		first = false;
+		result += "{\"serpID\":" + std::to_string(serpID) +
+			",\"responses\":" + std::to_string(histogram.count) +
+			",\"timeouts\":" + std::to_string(histogram.timeouts) +
+			",\"meanUs\":" + std::to_string(histogram.count > 0 ? histogram.sumMicroseconds / histogram.count : 0) +
+			",\"p50Us\":" + std::to_string(histogram.quantile(0.5)) +
+			",\"p99Us\":" + std::to_string(histogram.quantile(0.99)) + "}";
+	}
+	result += "]}";
+	return result;
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include "Network/SERP/SERPEndpoint.h"
+#include <mutex>
+#include <chrono>
+#include <array>
+#include <unordered_map>
+
+/// Histogram of response times with logarithmic buckets. Bucket i counts response times
+/// in [2^i, 2^(i+1)) microseconds.
+struct LatencyHistogram
+{
+	static constexpr std::size_t numberOfBuckets = 32;
+	std::array<uint64_t, numberOfBuckets> buckets{};
+	uint64_t count = 0;
+	uint64_t timeouts = 0;
+	uint64_t sumMicroseconds = 0;
+	/// Adds a response time to the histogram
+	void add(std::chrono::microseconds latency);
+	/// Returns an upper bound for the given quantile (between 0 and 1) in microseconds
+	uint64_t quantile(double q) const;
+};
+
+/// This class keeps track of relayed requests that are still waiting for a response. SERP messages
+/// carry no ID that links a response to its request, so responses are matched to the requests of the
+/// same source and destination in order: every request the destination gets from the source uses up
+/// the next sequence number of the pair (also requests that are not tracked, see countUntracked()),
+/// and every response completes the request with the next sequence number of the pair. Entries live in
+/// a fixed size open addressing table (linear probing) keyed by source, destination and sequence number.
+/// Deleting shifts the following entries back instead of leaving tombstones, st. the table never has
+/// to be rebuilt. All requests have the same timeout, so the entries are also linked into lists ordered
+/// by deadline, and expiring requests only touches the entries that expired.
+class RequestTracker
+{
+public:
+	/// A tracked request
+	struct Entry
+	{
+		/// Deadline in ns since the tracker was created, 0 marks an empty slot
+		int64_t deadline;
+		/// Time in ns since the tracker was created at which the request was relayed
+		int64_t relayTime;
+		uint32_t sequenceNumber;
+		uint16_t source;
+		uint16_t destination;
+		/// true if the request timed out and was answered by the server. The entry is kept for a grace
+		/// period (until deadline), st. the late response of the destination can be recognized.
+		bool timedOut;
+		/// Slots of the previous and next entry in the deadline list of the entry (noSlot at the ends)
+		uint32_t previous;
+		uint32_t next;
+	};
+	/// Result of matching a response to a tracked request
+	enum class Completion
+	{
+		/// The response answers a tracked request
+		COMPLETED,
+		/// The request timed out and the server answered it already, the response must be dropped
+		LATE,
+		/// The request was not tracked (the table was full, or the grace period is over)
+		UNTRACKED,
+	};
+private:
+	static constexpr int64_t emptySlot = 0;
+	static constexpr uint32_t noSlot = UINT32_MAX;
+	/// The table. Its size is a power of two.
+	std::vector<Entry> table;
+	/// Number of occupied slots
+	std::size_t numberOfOccupiedSlots = 0;
+	/// A list of entries ordered by deadline, linked through the slots of the table
+	struct DeadlineList
+	{
+		uint32_t first = noSlot;
+		uint32_t last = noSlot;
+	};
+	/// Requests that wait for their response, and requests that timed out and are in their grace period
+	DeadlineList waitingRequests;
+	DeadlineList timedOutRequests;
+	/// Number of requests that could not be tracked because the table was full
+	uint64_t untrackedRequests = 0;
+	/// Time after which a request without response times out
+	std::chrono::milliseconds timeout;
+	/// Time after the timeout during which a late response is still recognized (and dropped)
+	std::chrono::milliseconds gracePeriod;
+	/// Sequence numbers of the next request and the next response of each pair of source and destination
+	struct Pair
+	{
+		uint32_t nextRequest = 0;
+		uint32_t nextResponse = 0;
+	};
+	std::unordered_map<uint32_t, Pair> pairs;
+	/// Time the tracker was created, all times are stored relative to this
+	std::chrono::steady_clock::time_point startTime;
+	/// Response time histograms by destination SERPID
+	std::unordered_map<unsigned, LatencyHistogram> histograms;
+	/// Mutex for thread safe access
+	std::mutex mutex;
+	/// Returns the current time in ns since startTime
+	int64_t now() const;
+	/// Computes the slot index for the given key
+	std::size_t hash(uint16_t source, uint16_t destination, uint32_t sequenceNumber) const;
+	/// Helper functions for the deadline lists (called with the mutex held). An entry is in timedOutRequests
+	/// if its timedOut flag is set, else in waitingRequests.
+	DeadlineList& getList(const Entry& entry);
+	void append(DeadlineList& list, std::size_t index);
+	void unlink(DeadlineList& list, std::size_t index);
+	/// Helper function that returns the slot of the given request, or noSlot (called with the mutex held)
+	std::size_t find(uint16_t source, uint16_t destination, uint32_t sequenceNumber) const;
+	/// Helper function that removes the entry in the given slot (called with the mutex held)
+	void erase(std::size_t index);
+public:
+	/// Constructor. capacity is rounded up to the next power of two.
+	RequestTracker(std::size_t capacity, std::chrono::milliseconds timeout);
+	/// Starts tracking a relayed request
+	void track(SnackerEngine::SERPID source, SnackerEngine::SERPID destination);
+	/// Uses up the next sequence number of each pair for a request that is delivered but not tracked (eg.
+	/// the copies of a broadcast), st. its response does not complete a tracked request of the pair
+	void countUntracked(SnackerEngine::SERPID source, const std::vector<SnackerEngine::SERPID>& destinations);
+	/// Matches a response to the oldest request of the pair. source and destination are those of the
+	/// request (not the response).
+	Completion complete(SnackerEngine::SERPID source, SnackerEngine::SERPID destination);
+	/// Returns all requests that timed out since the last call. Their entries are released after the grace period.
+	std::vector<Entry> collectExpired();
+	/// Forgets the histogram, the pairs and the tracked requests of the given client (eg. because it disconnected)
+	void removeClient(SnackerEngine::SERPID serpID);
+	/// Returns a JSON object with the response time statistics of all destinations
+	std::string getStatistics();
+};
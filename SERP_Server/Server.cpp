@@ -1,7 +1,20 @@
 #include "Server.h"
 #include <iostream>
+#include <fstream>
+#include <algorithm>
 #include "Utility/Formatting.h"
 
+#ifdef _LINUX
+	#include <sys/un.h>
+	#include <sys/stat.h>
+#endif // _LINUX
+
+/// Helper function that returns the content of the given message as a string
+static std::string getContentAsString(const SnackerEngine::SERPMessage& message)
+{
+	return std::string(reinterpret_cast<const char*>(message.content.data()), message.content.size());
+}
+
 void Server::printMessage(const std::string& message)
 {
 	// Acquire lock
@@ -21,15 +34,18 @@ std::shared_ptr<Client> Server::getClient(SnackerEngine::SERPID serpID)
 	else return result->second;
 }
 
-void Server::connectClient(SnackerEngine::SocketTCP socket)
+void Server::connectClient(SnackerEngine::SocketTCP socket, bool local)
 {
+	// Apply the socket options before any data is exchanged
+	if (!applySocketProfile(socket, socketProfile, local)) printMessage("Could not apply all socket options to new connection.");
 	std::shared_ptr<Client> newClient = nullptr;
 	SnackerEngine::SERPID newSerpID = static_cast<unsigned int>(0);
 	{
 		// Acquire lock
 		std::lock_guard lock(clientsMapMutex);
-		// First we check if a client with the given address alredy has connected
-		for (auto& client : clients) {
+		// First we check if a client with the given address alredy has connected. Local clients
+		// don't have an address we could compare.
+		if (!local) for (auto& client : clients) {
 			if (SnackerEngine::compare(client.second->endpoint.getTCPEndpoint().getSocket().addr, socket.addr)) {
 				printMessage("Detected new connection request from client that was already connected.");
 				return;
@@ -39,35 +55,75 @@ void Server::connectClient(SnackerEngine::SocketTCP socket)
 		for (unsigned i = 0; i < numberOfRetriesSerpID; ++i) {
 			newSerpID = SnackerEngine::getRandomSerpID();
 			auto result = clients.find(static_cast<unsigned int>(newSerpID));
-			if (result == clients.end()) {
+			// SERPIDs of disconnected clients with a session are reserved for reclaiming
+			if (result == clients.end() && !sessions.contains(static_cast<unsigned int>(newSerpID))) {
 				success = true;
 				break;
 			}
 		}
 		if (success) {
-			newClient = std::make_shared<Client>(std::move(socket), newSerpID);
+#ifdef _LINUX
+			int numaNode = cpuPlacement ? cpuPlacement->assignClient(socket.sock) : -1;
+#endif // _LINUX
+			newClient = std::make_shared<Client>(std::move(socket), newSerpID, local, socketProfile);
+			newClient->memoryBudget = &memoryBudget;
+#ifdef _LINUX
+			newClient->cpuPlacement = cpuPlacement.get();
+			newClient->numaNode = numaNode;
+#endif // _LINUX
 			clients.insert(std::make_pair<>(static_cast<unsigned int>(newSerpID), newClient));
-			// Start sender and receiver threads
-			newClient->senderThread = std::thread(&Client::runSenderThread, newClient.get());
-			newClient->receiverThread = std::thread(&Server::runReceiverThread, this, newClient);
+#ifdef _IO_URING
+			// Remote clients are served by an I/O thread on their node
+			if (!local && !ioThreads.empty()) {
+#ifdef _LINUX
+				chooseIoThread(numaNode).addClient(newClient);
+#else
+				chooseIoThread(-1).addClient(newClient);
+#endif // _LINUX
+			}
+			else
+#endif // _IO_URING
+			{
+				// Start sender and receiver threads
+				newClient->senderThread = std::thread(&Client::runSenderThread, newClient.get());
+				newClient->receiverThread = std::thread(&Server::runReceiverThread, this, newClient);
+			}
 		}
 	}
 	if (newClient) {
-		printMessage("New client with serpID " + SnackerEngine::to_string(newSerpID) + " connected.");
+		printMessage("New " + std::string(local ? "local " : "") + "client with serpID " + SnackerEngine::to_string(newSerpID) + " connected.");
 	}
 }
 
 void Server::disconnectClient(SnackerEngine::SERPID serpID)
 {
-	// Acquire lock
-	std::lock_guard lockGuard(clientsMapMutex);
-	// Erase client from clients map
-	auto client = clients.find(static_cast<unsigned int>(serpID));
-	if (client != clients.end()) {
-		client->second->disconnect();
-		disconnectedClients.push_back(client->second);
-		clients.erase(client);
+	std::shared_ptr<Client> disconnectedClient = nullptr;
+	{
+		// Acquire lock
+		std::lock_guard lockGuard(clientsMapMutex);
+		// Erase client from clients map
+		auto client = clients.find(static_cast<unsigned int>(serpID));
+		if (client != clients.end()) {
+			// Keep the SERPID reserved for as long as stored messages for it are kept
+			auto session = sessions.find(static_cast<unsigned int>(serpID));
+#ifdef _LINUX
+			if (session != sessions.end()) session->second.expiry = std::chrono::steady_clock::now() + sessionTimeToLive;
+#else
+			if (session != sessions.end()) sessions.erase(session);
+#endif // _LINUX
+#ifdef _LINUX
+			if (cpuPlacement) cpuPlacement->releaseClient(client->second->numaNode);
+#endif // _LINUX
+			if (requestTracker) requestTracker->removeClient(serpID);
+			client->second->disconnectTime = std::chrono::steady_clock::now();
+			disconnectedClient = client->second;
+			disconnectedClients.push_back(client->second);
+			clients.erase(client);
+		}
 	}
+	// Stopping the sender thread can take a while if it is blocked on a full socket. The client is not
+	// in the map anymore, so we don't need to hold the lock for that.
+	if (disconnectedClient) disconnectedClient->disconnect();
 }
 
 void Server::sendMessageResponse(const SnackerEngine::SERPRequest& request, Client& client, SnackerEngine::ResponseStatusCode responseStatusCode, const std::string& message, SnackerEngine::SERPID sourceID)
@@ -106,14 +162,44 @@ void Server::relayRequest(Client& source, SnackerEngine::SERPID destination, std
 	// Check if the destination client is connected and relay the request if it is!
 	std::shared_ptr<Client> destinationClient = getClient(destination);
 	if (destinationClient) {
-		destinationClient->sendMesage(std::move(request));
+		if (!adaptCompression(*request, source.compressionCodec, destinationClient.get())) {
+			sendMessageResponse(static_cast<const SnackerEngine::SERPRequest&>(*request), source, SnackerEngine::ResponseStatusCode::BAD_REQUEST, "Could not decompress message body!", destination);
+			printMessage("Failed to relay request from client " + SnackerEngine::to_string(source.serpID) + " due to an invalid compressed body.");
+			return;
+		}
+		if (requestTracker) requestTracker->track(source.serpID, destination);
+		destinationClient->sendMesage(std::move(request), source.memoryAccount);
 		printMessage("Relayed request from client " + SnackerEngine::to_string(source.serpID) + " to client " + SnackerEngine::to_string(destination) + ".");
 	}
 	else {
-		// The requested client is not connected. Send this information to sender.
-		sendMessageResponse(static_cast<const SnackerEngine::SERPRequest&>(*request), source, SnackerEngine::ResponseStatusCode::NOT_FOUND, "no client with serpID " + SnackerEngine::to_string(destination) + " is currently connected.", destination);
-		printMessage("Tried to relay request from client " + SnackerEngine::to_string(source.serpID) + " to client " + SnackerEngine::to_string(destination) + ", but client " + SnackerEngine::to_string(destination) + " was not connected.");
+		handleUndeliverableRequest(source, destination, *request);
+	}
+}
+
+void Server::handleUndeliverableRequest(Client& source, SnackerEngine::SERPID destination, const SnackerEngine::SERPMessage& request, std::optional<SnackerEngine::Buffer>* decoded)
+{
+#ifdef _LINUX
+	bool hasSession = false;
+	if (messageStore && source.storeAndForward) {
+		// Only a client that can reclaim the SERPID will ever read the stored messages
+		std::lock_guard lockGuard(clientsMapMutex);
+		hasSession = sessions.contains(static_cast<unsigned int>(destination));
 	}
+	// We don't know which codec the destination will negotiate, so stored bodies are uncompressed
+	std::optional<SnackerEngine::SERPRequest> storedRequest;
+	if (hasSession) storedRequest.emplace(static_cast<const SnackerEngine::SERPRequest&>(request));
+	if (storedRequest.has_value() && adaptCompression(storedRequest.value(), source.compressionCodec, nullptr, decoded)) {
+		if (messageStore->store(destination, storedRequest.value())) {
+			// The destination answers once it reclaims its SERPID, so we don't answer here
+			printMessage("Stored request from client " + SnackerEngine::to_string(source.serpID) + " for client " + SnackerEngine::to_string(destination) + ", which is not connected.");
+			return;
+		}
+		printMessage("Could not store request from client " + SnackerEngine::to_string(source.serpID) + " for client " + SnackerEngine::to_string(destination) + ": storage limit reached.");
+	}
+#endif // _LINUX
+	// The requested client is not connected. Send this information to sender.
+	sendMessageResponse(static_cast<const SnackerEngine::SERPRequest&>(request), source, SnackerEngine::ResponseStatusCode::NOT_FOUND, "no client with serpID " + SnackerEngine::to_string(destination) + " is currently connected.", destination);
+	printMessage("Tried to relay request from client " + SnackerEngine::to_string(source.serpID) + " to client " + SnackerEngine::to_string(destination) + ", but client " + SnackerEngine::to_string(destination) + " was not connected.");
 }
 
 void Server::relayRequestMulti(Client& source, std::unique_ptr<SnackerEngine::SERPMessage> request)
@@ -123,18 +209,26 @@ void Server::relayRequestMulti(Client& source, std::unique_ptr<SnackerEngine::SE
 	std::unordered_set<uint16_t> destinations = request->getDestinations();
 	request->getHeader().setMultiSendFlag(false);
 	request->clearDestinations();
+	// The body is decoded at most once, for all destinations that did not negotiate its codec
+	CompressionCodec sourceCodec = source.compressionCodec;
+	std::optional<SnackerEngine::Buffer> decoded;
 	for (auto destination : destinations) {
 		// Check if the destination client is connected and relay the request if it is!
 		std::shared_ptr<Client> destinationClient = getClient(destination);
+		request->getHeader().destination = destination;
 		if (destinationClient) {
-			request->getHeader().destination = destination;
-			destinationClient->sendMesage(std::make_unique<SnackerEngine::SERPRequest>(*static_cast<SnackerEngine::SERPRequest*>(request.get())));
+			auto copy = std::make_unique<SnackerEngine::SERPRequest>(*static_cast<SnackerEngine::SERPRequest*>(request.get()));
+			if (!adaptCompression(*copy, sourceCodec, destinationClient.get(), &decoded)) {
+				sendMessageResponse(*copy, source, SnackerEngine::ResponseStatusCode::BAD_REQUEST, "Could not decompress message body!", destination);
+				printMessage("Failed to relay request from client " + SnackerEngine::to_string(source.serpID) + " due to an invalid compressed body.");
+				continue;
+			}
+			if (requestTracker) requestTracker->track(source.serpID, destination);
+			destinationClient->sendMesage(std::move(copy), source.memoryAccount);
 			printMessage("Relayed request from client " + SnackerEngine::to_string(source.serpID) + " to client " + SnackerEngine::to_string(destination) + ".");
 		}
 		else {
-			// The requested client is not connected. Send this information to sender.
-			sendMessageResponse(static_cast<const SnackerEngine::SERPRequest&>(*request), source, SnackerEngine::ResponseStatusCode::NOT_FOUND, "no client with serpID " + SnackerEngine::to_string(destination) + " is currently connected.", destination);
-			printMessage("Tried to relay request from client " + SnackerEngine::to_string(source.serpID) + " to client " + SnackerEngine::to_string(destination) + ", but client " + SnackerEngine::to_string(destination) + " was not connected.");
+			handleUndeliverableRequest(source, destination, *request, &decoded);
 		}
 	}
 }
@@ -142,10 +236,19 @@ void Server::relayRequestMulti(Client& source, std::unique_ptr<SnackerEngine::SE
 void Server::relayResponse(Client& source, SnackerEngine::SERPID destination, std::unique_ptr<SnackerEngine::SERPMessage> response)
 {
 	if (!prepareForRelay(*response, source)) return;
+	// The response goes back to the source of the request. If the request timed out, the server has answered it already.
+	if (requestTracker && requestTracker->complete(destination, source.serpID) == RequestTracker::Completion::LATE) {
+		printMessage("Dropped late response from client " + SnackerEngine::to_string(source.serpID) + " to client " + SnackerEngine::to_string(destination) + ", the request had timed out.");
+		return;
+	}
 	// Check if the destination client is connected and relay the response if it is!
 	std::shared_ptr<Client> destinationClient = getClient(destination);
 	if (destinationClient) {
-		destinationClient->sendMesage(std::move(response));
+		if (!adaptCompression(*response, source.compressionCodec, destinationClient.get())) {
+			printMessage("Failed to relay response from client " + SnackerEngine::to_string(source.serpID) + " due to an invalid compressed body.");
+			return;
+		}
+		destinationClient->sendMesage(std::move(response), source.memoryAccount);
 		printMessage("Relayed response from client " + SnackerEngine::to_string(source.serpID) + " to client " + SnackerEngine::to_string(destination) + ".");
 	}
 	else {
@@ -180,9 +283,442 @@ void Server::answerClientExistsRequest(Client& client, const SnackerEngine::SERP
 	}
 }
 
-void Server::handleIncomingRequestToServer(Client& client, std::unique_ptr<SnackerEngine::SERPMessage> request)
+void Server::answerPresenceRequest(Client& client, const SnackerEngine::SERPRequest& request)
 {
-	const SnackerEngine::SERPRequest& requestRef = static_cast<const SnackerEngine::SERPRequest&>(*request);
+	// Parse all SERPIDs before taking the lock
+	std::string body = getContentAsString(request);
+	std::vector<unsigned int> requestedClients;
+	std::size_t start = 0;
+	while (start < body.size()) {
+		std::size_t end = body.find(',', start);
+		if (end == std::string::npos) end = body.size();
+		auto requestedClientID = SnackerEngine::from_string<SnackerEngine::SERPID>(body.substr(start, end - start));
+		if (!requestedClientID.has_value() || requestedClients.size() >= maxPresenceQuerySize) {
+			sendMessageResponse(request, client, SnackerEngine::ResponseStatusCode::BAD_REQUEST, "Expected a list of at most " + std::to_string(maxPresenceQuerySize) + " serpIDs separated by commas!");
+			printMessage("Answered presence request from client " + SnackerEngine::to_string(client.serpID) + ": invalid list of serpIDs.");
+			return;
+		}
+		requestedClients.push_back(static_cast<unsigned int>(requestedClientID.value()));
+		start = end + 1;
+	}
+	std::string bitmap((requestedClients.size() + 7) / 8, '\0');
+	std::size_t numberOfConnectedClients = 0;
+	{
+		// Acquire lock once for all lookups
+		std::lock_guard lockGuard(clientsMapMutex);
+		for (std::size_t i = 0; i < requestedClients.size(); ++i) {
+			if (!clients.contains(requestedClients[i])) continue;
+			bitmap[i / 8] = static_cast<char>(bitmap[i / 8] | (1 << (i % 8)));
+			numberOfConnectedClients++;
+		}
+	}
+	sendMessageResponse(request, client, SnackerEngine::ResponseStatusCode::OK, bitmap);
+	printMessage("Answered presence request from client " + SnackerEngine::to_string(client.serpID) + ": " + std::to_string(numberOfConnectedClients) + " of " + std::to_string(requestedClients.size()) + " clients are connected.");
+}
+
+#ifdef _LINUX
+void Server::answerSharedMemoryRequest(Client& client, const SnackerEngine::SERPRequest& request)
+{
+	if (!client.local) {
+		sendMessageResponse(request, client, SnackerEngine::ResponseStatusCode::BAD_REQUEST, "Shared memory is only available for clients connected through the local socket!");
+		printMessage("Client " + SnackerEngine::to_string(client.serpID) + " requested shared memory transport but is not a local client.");
+		return;
+	}
+	std::optional<std::string> segmentName = client.createSharedMemory(sharedMemoryRingCapacity);
+	if (!segmentName.has_value()) {
+		sendMessageResponse(request, client, SnackerEngine::ResponseStatusCode::BAD_REQUEST, "Could not create a shared memory segment!");
+		printMessage("Client " + SnackerEngine::to_string(client.serpID) + " requested shared memory transport, but no segment could be created.");
+		return;
+	}
+	// The response still goes over the socket. Once the client has mapped the segment and written to it,
+	// messages can arrive on either transport.
+	sendMessageResponse(request, client, SnackerEngine::ResponseStatusCode::OK, segmentName.value());
+	printMessage("Created shared memory segment \"" + segmentName.value() + "\" for client " + SnackerEngine::to_string(client.serpID) + ".");
+}
+
+void Server::answerThreadStatisticsRequest(Client& client, const SnackerEngine::SERPRequest& request)
+{
+	if (!cpuPlacement) {
+		sendMessageResponse(request, client, SnackerEngine::ResponseStatusCode::NOT_FOUND, "CPU placement is disabled!");
+		printMessage("Client " + SnackerEngine::to_string(client.serpID) + " requested thread statistics, but CPU placement is disabled.");
+		return;
+	}
+	sendMessageResponse(request, client, SnackerEngine::ResponseStatusCode::OK, cpuPlacement->getStatistics());
+	printMessage("Answered thread statistics request from client " + SnackerEngine::to_string(client.serpID) + ".");
+}
+
+void Server::answerStoreAndForwardRequest(Client& client, const SnackerEngine::SERPRequest& request)
+{
+	std::string body = getContentAsString(request);
+	if (!messageStore) {
+		sendMessageResponse(request, client, SnackerEngine::ResponseStatusCode::NOT_FOUND, "The message store is disabled!");
+		printMessage("Client " + SnackerEngine::to_string(client.serpID) + " requested store-and-forward, but the message store is disabled.");
+		return;
+	}
+	if (body != "on" && body != "off") {
+		sendMessageResponse(request, client, SnackerEngine::ResponseStatusCode::BAD_REQUEST, "Expected \"on\" or \"off\"!");
+		printMessage("Answered store-and-forward request from client " + SnackerEngine::to_string(client.serpID) + ": invalid body.");
+		return;
+	}
+	client.storeAndForward = body == "on";
+	sendMessageResponse(request, client, SnackerEngine::ResponseStatusCode::OK, body);
+	printMessage("Client " + SnackerEngine::to_string(client.serpID) + " turned store-and-forward " + body + ".");
+}
+#endif // _LINUX
+
+void Server::answerCompressionRequest(Client& client, const SnackerEngine::SERPRequest& request)
+{
+	// The body lists the codecs the client supports, in order of preference and separated by commas
+	std::string codecs = getContentAsString(request);
+	CompressionCodec codec = CompressionCodec::NONE;
+	std::size_t start = 0;
+	while (start <= codecs.size()) {
+		std::size_t end = codecs.find(',', start);
+		if (end == std::string::npos) end = codecs.size();
+		auto supportedCodec = parseCompressionCodec(codecs.substr(start, end - start));
+		if (supportedCodec.has_value()) {
+			codec = supportedCodec.value();
+			break;
+		}
+		start = end + 1;
+	}
+	client.compressionCodec = codec;
+	sendMessageResponse(request, client, SnackerEngine::ResponseStatusCode::OK, to_string(codec));
+	printMessage("Client " + SnackerEngine::to_string(client.serpID) + " negotiated compression codec \"" + to_string(codec) + "\".");
+}
+
+bool Server::adaptCompression(SnackerEngine::SERPMessage& message, CompressionCodec sourceCodec, const Client* destination, std::optional<SnackerEngine::Buffer>* decoded)
+{
+	// The codec can be renegotiated at any time, so we only read it once
+	CompressionCodec destinationCodec = destination ? destination->compressionCodec.load() : CompressionCodec::NONE;
+	if (sourceCodec != CompressionCodec::NONE && isFramedBody(message.content)) {
+		std::optional<CompressionCodec> frameCodec = getFrameCodec(message.content);
+		if (!frameCodec.has_value() || (frameCodec.value() != CompressionCodec::NONE && frameCodec.value() != sourceCodec)) return false;
+		if (destinationCodec != CompressionCodec::NONE && (frameCodec.value() == CompressionCodec::NONE || frameCodec.value() == destinationCodec)) return true;
+		if (decoded && decoded->has_value()) message.content = decoded->value();
+		else {
+			SnackerEngine::Buffer decompressed;
+			if (!decompressBuffer(message.content, decompressed, maxDecompressedSize)) return false;
+			if (decoded) *decoded = decompressed;
+			message.content = std::move(decompressed);
+		}
+	}
+	// The destination would take a plain body that starts with the magic number for a frame
+	if (destinationCodec != CompressionCodec::NONE && isFramedBody(message.content)) {
+		SnackerEngine::Buffer escaped;
+		compressBuffer(CompressionCodec::NONE, message.content, escaped);
+		message.content = std::move(escaped);
+	}
+	return true;
+}
+
+void Server::answerSessionTokenRequest(Client& client, const SnackerEngine::SERPRequest& request)
+{
+	uint64_t token = 0;
+	{
+		std::lock_guard lockGuard(clientsMapMutex);
+		auto session = sessions.find(static_cast<unsigned int>(client.serpID));
+		if (session == sessions.end()) {
+			token = sessionTokenGenerator();
+			sessions.insert(std::make_pair<>(static_cast<unsigned int>(client.serpID), Session{ token, std::chrono::steady_clock::time_point::max() }));
+		}
+		else token = session->second.token;
+	}
+	sendMessageResponse(request, client, SnackerEngine::ResponseStatusCode::OK, std::to_string(token));
+	printMessage("Answered sessionToken request from client " + SnackerEngine::to_string(client.serpID) + ".");
+}
+
+void Server::answerReclaimRequest(Client& client, const SnackerEngine::SERPRequest& request, const std::string& requestedClient)
+{
+	auto requestedClientID = SnackerEngine::from_string<SnackerEngine::SERPID>(requestedClient);
+	std::string token = getContentAsString(request);
+	if (!requestedClientID.has_value()) {
+		sendMessageResponse(request, client, SnackerEngine::ResponseStatusCode::BAD_REQUEST, "\"" + requestedClient + "\" is not a valid SerpID!");
+		printMessage("Answered reclaim request from client " + SnackerEngine::to_string(client.serpID) + ": \"" + requestedClient + "\" is not a valid SerpID.");
+		return;
+	}
+	SnackerEngine::SERPID oldSerpID = client.serpID;
+	SnackerEngine::SERPID newSerpID = requestedClientID.value();
+	bool success = false;
+	{
+		std::lock_guard lockGuard(clientsMapMutex);
+		auto session = sessions.find(static_cast<unsigned int>(newSerpID));
+		if (session != sessions.end() && std::to_string(session->second.token) == token && !clients.contains(static_cast<unsigned int>(newSerpID))) {
+			// Move the client to its old SERPID. The session stays, it is now reserved for the client again.
+			auto currentClient = clients.find(static_cast<unsigned int>(oldSerpID));
+			if (currentClient != clients.end()) {
+				std::shared_ptr<Client> clientPtr = currentClient->second;
+				clients.erase(currentClient);
+				sessions.erase(static_cast<unsigned int>(oldSerpID));
+				client.serpID = newSerpID;
+				clients.insert(std::make_pair<>(static_cast<unsigned int>(newSerpID), clientPtr));
+				session->second.expiry = std::chrono::steady_clock::time_point::max();
+				success = true;
+			}
+		}
+	}
+	if (!success) {
+		sendMessageResponse(request, client, SnackerEngine::ResponseStatusCode::NOT_FOUND, "Could not reclaim serpID " + requestedClient + "!");
+		printMessage("Answered reclaim request from client " + SnackerEngine::to_string(oldSerpID) + ": serpID " + requestedClient + " could not be reclaimed.");
+		return;
+	}
+	sendMessageResponse(request, client, SnackerEngine::ResponseStatusCode::OK, SnackerEngine::to_string(newSerpID));
+	printMessage("Client " + SnackerEngine::to_string(oldSerpID) + " reclaimed serpID " + requestedClient + ".");
+	// Reading the stored messages can take a while, let a worker do it. The task is queued like a request of
+	// the client, st. the next reclaim waits for it.
+	std::shared_ptr<Client> clientPtr = workerPool ? getClient(newSerpID) : nullptr;
+	if (clientPtr) submitServerRequest(clientPtr, [this, clientPtr]() { replayStoredMessages(*clientPtr); });
+	else replayStoredMessages(client);
+}
+
+void Server::answerBroadcastRequest(Client& client, SnackerEngine::SERPRequest& request, const std::vector<std::string>& path)
+{
+	if (!prepareForRelay(request, client)) return;
+	// The receivers see the target without the broadcast prefix. The header is left as it is (source is the
+	// sender, destination is the server), a header per receiver would mean a serialization per receiver.
+	std::string target;
+	for (std::size_t i = 1; i < path.size(); ++i) target += (i > 1 ? "/" : "") + path[i];
+	request.target = target;
+	// The serialized request is charged once, to the sender, and released when the last queue has sent it
+	std::shared_ptr<ChargedBuffer> chargedBuffer = std::make_shared<ChargedBuffer>();
+	chargedBuffer->buffer = request.serialize();
+	chargedBuffer->charge = MemoryCharge(memoryBudget, nullptr, client.memoryAccount, chargedBuffer->buffer.size());
+	std::shared_ptr<const SnackerEngine::Buffer> serialized(chargedBuffer, &chargedBuffer->buffer);
+	// Receivers that negotiated a codec would take a body that starts with the magic number for a frame, they
+	// get a second serialization with the escaped body
+	std::shared_ptr<const SnackerEngine::Buffer> escapedSerialized = serialized;
+	if (isFramedBody(request.content)) {
+		SnackerEngine::SERPRequest escapedRequest(request);
+		compressBuffer(CompressionCodec::NONE, request.content, escapedRequest.content);
+		std::shared_ptr<ChargedBuffer> escapedBuffer = std::make_shared<ChargedBuffer>();
+		escapedBuffer->buffer = escapedRequest.serialize();
+		escapedBuffer->charge = MemoryCharge(memoryBudget, nullptr, client.memoryAccount, escapedBuffer->buffer.size());
+		escapedSerialized = std::shared_ptr<const SnackerEngine::Buffer>(escapedBuffer, &escapedBuffer->buffer);
+	}
+	std::vector<std::shared_ptr<Client>> receivers;
+	std::vector<SnackerEngine::SERPID> receiverIDs;
+	{
+		// Acquire lock
+		std::lock_guard lockGuard(clientsMapMutex);
+		receivers.reserve(clients.size());
+		receiverIDs.reserve(clients.size());
+		for (auto& receiver : clients) {
+			if (receiver.second.get() == &client) continue;
+			receivers.push_back(receiver.second);
+			receiverIDs.push_back(receiver.second->serpID);
+		}
+	}
+	// Enqueue in chunks. With a worker pool, the chunks are spread over the workers and other requests
+	// to the server can be handled in between.
+	SnackerEngine::SERPID source = client.serpID;
+	for (std::size_t first = 0; first < receivers.size(); first += broadcastChunkSize) {
+		std::size_t last = std::min(first + broadcastChunkSize, receivers.size());
+		std::vector<std::shared_ptr<Client>> chunk(receivers.begin() + first, receivers.begin() + last);
+		std::vector<SnackerEngine::SERPID> chunkIDs(receiverIDs.begin() + first, receiverIDs.begin() + last);
+		auto enqueue = [this, source, chunk, chunkIDs, serialized, escapedSerialized]() {
+			// The copies are not tracked, but the responses of the receivers must not complete tracked requests
+			if (requestTracker) requestTracker->countUntracked(source, chunkIDs);
+			for (auto& receiver : chunk) receiver->sendSerializedMessage(receiver->compressionCodec == CompressionCodec::NONE ? serialized : escapedSerialized);
+		};
+		if (workerPool) workerPool->submit(enqueue);
+		else enqueue();
+	}
+	sendMessageResponse(request, client, SnackerEngine::ResponseStatusCode::OK, std::to_string(receivers.size()));
+	printMessage("Broadcasted request from client " + SnackerEngine::to_string(client.serpID) + " to " + std::to_string(receivers.size()) + " clients.");
+}
+
+void Server::replayStoredMessages(Client& client)
+{
+#ifdef _LINUX
+	// Replay all stored messages in one go
+	if (!messageStore) return;
+	std::vector<std::unique_ptr<SnackerEngine::SERPMessage>> storedMessages = messageStore->takeMessages(client.serpID);
+	if (!storedMessages.empty()) {
+		// Stored bodies are plain, they may have to be escaped for the codec the client negotiated
+		for (auto& storedMessage : storedMessages) {
+			adaptCompression(*storedMessage, CompressionCodec::NONE, &client);
+			if (requestTracker) requestTracker->countUntracked(storedMessage->getHeader().source, { client.serpID });
+		}
+		std::size_t numberOfStoredMessages = storedMessages.size();
+		client.sendMessages(std::move(storedMessages));
+		printMessage("Replayed " + SnackerEngine::to_string(numberOfStoredMessages) + " stored messages to client " + SnackerEngine::to_string(client.serpID) + ".");
+	}
+#endif // _LINUX
+}
+
+void Server::answerLatencyStatisticsRequest(Client& client, const SnackerEngine::SERPRequest& request)
+{
+	if (!requestTracker) {
+		sendMessageResponse(request, client, SnackerEngine::ResponseStatusCode::NOT_FOUND, "Request tracking is disabled!");
+		printMessage("Client " + SnackerEngine::to_string(client.serpID) + " requested latency statistics, but request tracking is disabled.");
+		return;
+	}
+	sendMessageResponse(request, client, SnackerEngine::ResponseStatusCode::OK, requestTracker->getStatistics());
+	printMessage("Answered latency statistics request from client " + SnackerEngine::to_string(client.serpID) + ".");
+}
+
+void Server::answerCaptureStatisticsRequest(Client& client, const SnackerEngine::SERPRequest& request)
+{
+	if (!trafficCapture) {
+		sendMessageResponse(request, client, SnackerEngine::ResponseStatusCode::NOT_FOUND, "Capturing is disabled!");
+		printMessage("Client " + SnackerEngine::to_string(client.serpID) + " requested capture statistics, but capturing is disabled.");
+		return;
+	}
+	sendMessageResponse(request, client, SnackerEngine::ResponseStatusCode::OK, "{\"droppedMessages\":" + std::to_string(trafficCapture->getDroppedMessages()) + "}");
+	printMessage("Answered capture statistics request from client " + SnackerEngine::to_string(client.serpID) + ".");
+}
+
+void Server::runRequestTimeoutThread()
+{
+#ifdef _LINUX
+	if (cpuPlacement) cpuPlacement->pinCurrentThread();
+#endif // _LINUX
+	while (requestTimeoutThreadRunning) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(requestTimeoutCheckInterval));
+		for (const RequestTracker::Entry& entry : requestTracker->collectExpired()) {
+			std::shared_ptr<Client> sourceClient = getClient(entry.source);
+			if (!sourceClient) continue;
+			// The response is built from a request that only carries the header fields
+			SnackerEngine::SERPRequest request(SnackerEngine::RequestStatusCode::GET, "");
+			request.getHeader().source = entry.source;
+			request.getHeader().destination = entry.destination;
+			// There is no status code for timeouts, the destination is treated like one that is not connected
+			sendMessageResponse(request, *sourceClient, SnackerEngine::ResponseStatusCode::NOT_FOUND, "client " + SnackerEngine::to_string(SnackerEngine::SERPID(entry.destination)) + " did not respond in time.", entry.destination);
+			printMessage("Request from client " + SnackerEngine::to_string(SnackerEngine::SERPID(entry.source)) + " to client " + SnackerEngine::to_string(SnackerEngine::SERPID(entry.destination)) + " timed out.");
+		}
+	}
+}
+
+std::vector<std::pair<SnackerEngine::SERPID, std::shared_ptr<MemoryAccount>>> Server::getMemoryAccounts()
+{
+	std::vector<std::pair<SnackerEngine::SERPID, std::shared_ptr<MemoryAccount>>> accounts;
+	std::lock_guard lockGuard(clientsMapMutex);
+	accounts.reserve(clients.size());
+	for (auto& client : clients) accounts.push_back(std::make_pair<>(client.second->serpID, client.second->memoryAccount));
+	return accounts;
+}
+
+void Server::runMemoryBudgetThread()
+{
+#ifdef _LINUX
+	if (cpuPlacement) cpuPlacement->pinCurrentThread();
+#endif // _LINUX
+	while (memoryBudgetThreadRunning) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(memoryBudgetCheckInterval));
+		auto shedClient = memoryBudget.enforce(getMemoryAccounts());
+		if (shedClient.has_value()) {
+			printMessage("Memory budget exceeded, disconnecting client " + SnackerEngine::to_string(shedClient.value()) + " which holds the most memory.");
+			disconnectClient(shedClient.value());
+		}
+	}
+}
+
+void Server::answerMemoryStatisticsRequest(Client& client, const SnackerEngine::SERPRequest& request)
+{
+	sendMessageResponse(request, client, SnackerEngine::ResponseStatusCode::OK, memoryBudget.getStatistics(getMemoryAccounts()));
+	printMessage("Answered memory statistics request from client " + SnackerEngine::to_string(client.serpID) + ".");
+}
+
+void Server::answerResourceStatisticsRequest(Client& client, const SnackerEngine::SERPRequest& request)
+{
+	std::size_t numberOfConnectedClients = 0;
+	std::size_t numberOfDisconnectedClients = 0;
+	std::size_t numberOfSessions = 0;
+	{
+		std::lock_guard lock(clientsMapMutex);
+		numberOfConnectedClients = clients.size();
+		numberOfDisconnectedClients = disconnectedClients.size();
+		numberOfSessions = sessions.size();
+	}
+	uint64_t residentBytes = 0;
+	uint64_t numberOfThreads = 0;
+#ifdef _LINUX
+	// Resident set size (in kB) and thread count of the whole process
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line)) {
+		if (line.starts_with("VmRSS:")) residentBytes = std::strtoull(line.c_str() + 6, nullptr, 10) * 1024;
+		else if (line.starts_with("Threads:")) numberOfThreads = std::strtoull(line.c_str() + 8, nullptr, 10);
+	}
+#endif // _LINUX
+	std::string result = "{\"residentBytes\":" + std::to_string(residentBytes) +
+		",\"threads\":" + std::to_string(numberOfThreads) +
+		",\"liveClients\":" + std::to_string(Client::numberOfLiveClients.load()) +
+		",\"connectedClients\":" + std::to_string(numberOfConnectedClients) +
+		",\"disconnectedClients\":" + std::to_string(numberOfDisconnectedClients) +
+		",\"sessions\":" + std::to_string(numberOfSessions) + "}";
+	sendMessageResponse(request, client, SnackerEngine::ResponseStatusCode::OK, result);
+	printMessage("Answered resource statistics request from client " + SnackerEngine::to_string(client.serpID) + ".");
+}
+
+void Server::answerWorkerStatisticsRequest(Client& client, const SnackerEngine::SERPRequest& request)
+{
+	if (!workerPool) {
+		sendMessageResponse(request, client, SnackerEngine::ResponseStatusCode::NOT_FOUND, "The worker pool is disabled!");
+		printMessage("Client " + SnackerEngine::to_string(client.serpID) + " requested worker statistics, but the worker pool is disabled.");
+		return;
+	}
+	sendMessageResponse(request, client, SnackerEngine::ResponseStatusCode::OK, workerPool->getStatistics());
+	printMessage("Answered worker statistics request from client " + SnackerEngine::to_string(client.serpID) + ".");
+}
+
+void Server::dispatchRequestToServer(Client& client, std::unique_ptr<SnackerEngine::SERPMessage> request)
+{
+	std::vector<std::string> path = SnackerEngine::SERPRequest::splitTargetPath(static_cast<const SnackerEngine::SERPRequest&>(*request).target);
+	bool changesConnection = !path.empty() && (path[0] == "reclaim" || path[0] == "sharedMemory");
+	std::shared_ptr<Client> clientPtr = workerPool ? getClient(client.serpID) : nullptr;
+	if (!clientPtr) {
+		handleIncomingRequestToServer(client, *request);
+		return;
+	}
+	// std::function needs a copyable task
+	std::shared_ptr<SnackerEngine::SERPMessage> sharedRequest = std::move(request);
+	if (changesConnection) {
+		// Earlier requests have to be answered first, and they read the serpID that a reclaim changes. Instead
+		// of waiting for them, we stop reading from the client until the change was made by a worker.
+		clientPtr->connectionChangePending = true;
+		submitServerRequest(clientPtr, [this, clientPtr, sharedRequest]() {
+			handleIncomingRequestToServer(*clientPtr, *sharedRequest);
+			clientPtr->connectionChangePending = false;
+		});
+		return;
+	}
+	submitServerRequest(clientPtr, [this, clientPtr, sharedRequest]() { handleIncomingRequestToServer(*clientPtr, *sharedRequest); });
+}
+
+void Server::submitServerRequest(std::shared_ptr<Client> client, std::function<void()> task)
+{
+	{
+		std::lock_guard lockGuard(client->serverRequestMutex);
+		client->serverRequests.push(std::move(task));
+		// A worker is already working through the queue of this client
+		if (client->serverRequestsRunning) return;
+		client->serverRequestsRunning = true;
+	}
+	workerPool->submit([this, client]() { runServerRequests(*client); });
+}
+
+void Server::runServerRequests(Client& client)
+{
+	std::unique_lock lock(client.serverRequestMutex);
+	while (!client.serverRequests.empty()) {
+		std::function<void()> task = std::move(client.serverRequests.front());
+		client.serverRequests.pop();
+		lock.unlock();
+		task();
+		lock.lock();
+	}
+	client.serverRequestsRunning = false;
+}
+
+void Server::handleIncomingRequestToServer(Client& client, SnackerEngine::SERPMessage& request)
+{
+	const SnackerEngine::SERPRequest& requestRef = static_cast<const SnackerEngine::SERPRequest&>(request);
+	if (!adaptCompression(request, client.compressionCodec, nullptr)) {
+		sendMessageResponse(requestRef, client, SnackerEngine::ResponseStatusCode::BAD_REQUEST, "Could not decompress message body!");
+		printMessage("Client " + SnackerEngine::to_string(client.serpID) + " sent a request with an invalid compressed body to server.");
+		return;
+	}
 	std::vector<std::string> path = SnackerEngine::SERPRequest::splitTargetPath(requestRef.target);
 	if (path.size() <= 2 && requestRef.getRequestStatusCode() == SnackerEngine::RequestStatusCode::GET) {
 		if (path.back() == "ping") {
@@ -190,16 +726,72 @@ void Server::handleIncomingRequestToServer(Client& client, std::unique_ptr<Snack
 			printMessage("Answered ping request from client " + SnackerEngine::to_string(client.serpID) + ".");
 			return;
 		}
+		else if (path.size() == 1 && path[0] == "sessionToken") {
+			answerSessionTokenRequest(client, requestRef);
+			return;
+		}
 		else if (path.back() == "serpID") {
 			sendMessageResponse(requestRef, client, SnackerEngine::ResponseStatusCode::OK, SnackerEngine::to_string(client.serpID));
 			printMessage("Answered serpID request from client " + SnackerEngine::to_string(client.serpID) + ".");
 			return;
 		}
+		else if (path.size() == 2 && path[0] == "stats" && path[1] == "memory") {
+			answerMemoryStatisticsRequest(client, requestRef);
+			return;
+		}
+		else if (path.size() == 2 && path[0] == "stats" && path[1] == "resources") {
+			answerResourceStatisticsRequest(client, requestRef);
+			return;
+		}
+		else if (path.size() == 2 && path[0] == "stats" && path[1] == "workers") {
+			answerWorkerStatisticsRequest(client, requestRef);
+			return;
+		}
+		else if (path.size() == 2 && path[0] == "stats" && path[1] == "latency") {
+			answerLatencyStatisticsRequest(client, requestRef);
+			return;
+		}
+		else if (path.size() == 2 && path[0] == "stats" && path[1] == "capture") {
+			answerCaptureStatisticsRequest(client, requestRef);
+			return;
+		}
+#ifdef _LINUX
+		else if (path.size() == 2 && path[0] == "stats" && path[1] == "threads") {
+			answerThreadStatisticsRequest(client, requestRef);
+			return;
+		}
+#endif // _LINUX
 		else if (path.size() == 2 && path[0] == "clients") {
 			answerClientExistsRequest(client, requestRef, path[1]);
 			return;
 		}
 	}
+	else if (path.size() >= 2 && path[0] == "broadcast" && requestRef.getRequestStatusCode() == SnackerEngine::RequestStatusCode::POST) {
+		answerBroadcastRequest(client, static_cast<SnackerEngine::SERPRequest&>(request), path);
+		return;
+	}
+	else if (path.size() == 1 && path[0] == "clients" && requestRef.getRequestStatusCode() == SnackerEngine::RequestStatusCode::POST) {
+		answerPresenceRequest(client, requestRef);
+		return;
+	}
+	else if (path.size() == 1 && path[0] == "compression" && requestRef.getRequestStatusCode() == SnackerEngine::RequestStatusCode::POST) {
+		answerCompressionRequest(client, requestRef);
+		return;
+	}
+	else if (path.size() == 2 && path[0] == "reclaim" && requestRef.getRequestStatusCode() == SnackerEngine::RequestStatusCode::POST) {
+		answerReclaimRequest(client, requestRef, path[1]);
+		return;
+	}
+#ifdef _LINUX
+	else if (path.size() == 1 && path[0] == "sharedMemory" && requestRef.getRequestStatusCode() == SnackerEngine::RequestStatusCode::POST) {
+		answerSharedMemoryRequest(client, requestRef);
+		return;
+	}
+	else if (path.size() == 1 && path[0] == "storeAndForward" && requestRef.getRequestStatusCode() == SnackerEngine::RequestStatusCode::POST) {
+		answerStoreAndForwardRequest(client, requestRef);
+		return;
+	}
+#endif // _LINUX
 	sendMessageResponse(requestRef, client, SnackerEngine::ResponseStatusCode::NOT_FOUND, ("Did not find target \"" + requestRef.target + "\""));
 	printMessage("Client sent request with invalid target \"" + requestRef.target + "\" to server.");
 }
@@ -212,7 +804,7 @@ void Server::handleIncomingRequest(Client& client, std::unique_ptr<SnackerEngine
 	}
 	else if (request->getHeader().destination == 0) {
 		// The message is directed at the server!
-		handleIncomingRequestToServer(client, std::move(request));
+		dispatchRequestToServer(client, std::move(request));
 	}
 	else {
 		// The message is directed to another client. Try to relay.
@@ -235,19 +827,49 @@ void Server::handleIncomingMessage(Client& client)
 		disconnectClient(client.serpID);
 	}
 	else {
-		for (unsigned int i = 0; i < result.value().size(); ++i) {
-			if (result.value()[i]->isRequest()) {
-				handleIncomingRequest(client, std::move(result.value()[i]));
-			}
-			else {
-				handleIncomingResponse(client, std::move(result.value()[i]));
-			}
+		handleIncomingMessages(client, result.value());
+	}
+}
+
+void Server::handleIncomingMessages(Client& client, std::vector<std::unique_ptr<SnackerEngine::SERPMessage>>& messages)
+{
+	if (trafficCapture) {
+		for (auto& message : messages) trafficCapture->capture(client.serpID, *message);
+	}
+	processIncomingMessages(client, messages);
+}
+
+void Server::processIncomingMessages(Client& client, std::vector<std::unique_ptr<SnackerEngine::SERPMessage>>& messages)
+{
+	for (std::size_t i = 0; i < messages.size(); ++i) {
+		// The following messages may read the serpID a pending reclaim changes, they wait until it is done
+		if (client.connectionChangePending) {
+			client.heldMessages.insert(client.heldMessages.end(), std::make_move_iterator(messages.begin() + i), std::make_move_iterator(messages.end()));
+			return;
+		}
+		if (messages[i]->isRequest()) {
+			handleIncomingRequest(client, std::move(messages[i]));
+		}
+		else {
+			handleIncomingResponse(client, std::move(messages[i]));
 		}
 	}
 }
 
+void Server::processHeldMessages(Client& client)
+{
+	if (client.heldMessages.empty()) return;
+	std::vector<std::unique_ptr<SnackerEngine::SERPMessage>> messages = std::move(client.heldMessages);
+	client.heldMessages.clear();
+	processIncomingMessages(client, messages);
+}
+
 void Server::runReceiverThread(std::shared_ptr<Client> client)
 {
+#ifdef _LINUX
+	// Pin the thread before it allocates anything, st. its buffers are placed on the node of the client
+	if (cpuPlacement) cpuPlacement->pinCurrentThread(client->numaNode);
+#endif // _LINUX
 	// Create poll file descriptor for listening to received messages on client socket
 #ifdef _WINDOWS
 	pollfd clientPollFD(client->endpoint.getTCPEndpoint().getSocket().sock, POLLRDNORM, NULL);
@@ -256,13 +878,25 @@ void Server::runReceiverThread(std::shared_ptr<Client> client)
 	pollfd clientPollFD(client->endpoint.getTCPEndpoint().getSocket().sock, POLLRDNORM, 0);
 #endif // _LINUX
 	while (client->connected) {
+		if (client->isReceivingPaused()) {
+			// Backpressure: leave the data in the socket until the server has memory again, or until the
+			// connection change of the client was made
+			std::this_thread::sleep_for(std::chrono::milliseconds(memoryPauseInterval));
+			continue;
+		}
+		if (!client->heldMessages.empty()) {
+			processHeldMessages(*client);
+			continue;
+		}
 		// Listen for message
 #ifdef _WINDOWS
 		int result = WSAPoll(&clientPollFD, 1, pollFdTimeout);
 		if (result == SOCKET_ERROR) {
 #endif // _WINDOWS
 #ifdef _LINUX
-		int result = poll(&clientPollFD, 1, pollFdTimeout);
+		// With a shared memory segment we wait on the ring instead, the socket is only checked
+		bool sharedMemoryAttached = client->sharedMemoryChannel != nullptr;
+		int result = poll(&clientPollFD, 1, sharedMemoryAttached ? 0 : pollFdTimeout);
 		if (result == -1) {
 #endif // _LINUX
 		
@@ -282,7 +916,7 @@ void Server::runReceiverThread(std::shared_ptr<Client> client)
 			disconnectClient(client->serpID);
 			break;
 		}
-		else if (clientPollFD.revents & POLLERR) {
+		else if ((clientPollFD.revents & POLLERR) && client->hasSocketError()) {
 			// Client socket disconnected with error. Write error to chat, disconnect client and end thread
 			printMessage("Client with SERPID " + SnackerEngine::to_string(client->serpID) + " disconnected with error.");
 			disconnectClient(client->serpID);
@@ -299,48 +933,402 @@ void Server::runReceiverThread(std::shared_ptr<Client> client)
 			printMessage("Client with SERPID " + SnackerEngine::to_string(client->serpID) + " has sent a message.");
 			handleIncomingMessage(*client);
 		}
+#ifdef _LINUX
+		else if (clientPollFD.revents & POLLERR) {
+			// Only completions of zero copy sends wait on the error queue. poll() reports them until the sender
+			// thread has read them, so we wake it up instead of polling again right away.
+			client->conditionVariable.notify_one();
+			std::this_thread::sleep_for(std::chrono::milliseconds(client->zeroCopyReapInterval));
+		}
+		if (sharedMemoryAttached && client->connected && !client->connectionChangePending) {
+			bool doorbell = false;
+			auto messages = client->sharedMemoryChannel->receiveMessages(result > 0 ? 0 : static_cast<int>(pollFdTimeout), doorbell);
+			if (!messages.has_value()) {
+				printMessage("Client with SERPID " + SnackerEngine::to_string(client->serpID) + " wrote a malformed message to shared memory.");
+				disconnectClient(client->serpID);
+				break;
+			}
+			// The client has mapped the segment, from now on we send over the ring as well
+			if (!messages.value().empty()) client->sharedMemoryAttached = true;
+			handleIncomingMessages(*client, messages.value());
+			// On a doorbell the next call to poll() picks up the message on the socket
+		}
+#endif // _LINUX
 	}
 	client->receiverThreadFinished = true;
 }
 
+#ifdef _LINUX
+bool Server::createLocalSocket()
+{
+	sockaddr_un address{};
+	if (localSocketPath.size() >= sizeof(address.sun_path)) return false;
+	address.sun_family = AF_UNIX;
+	std::memcpy(address.sun_path, localSocketPath.c_str(), localSocketPath.size() + 1);
+	// Only remove a stale socket file left behind by a previous server, never a live socket or any other file
+	struct stat fileStatus {};
+	if (lstat(localSocketPath.c_str(), &fileStatus) == 0) {
+		if (!S_ISSOCK(fileStatus.st_mode)) throw std::runtime_error("\"" + localSocketPath + "\" exists and is not a socket!");
+		int probeSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (probeSocket == -1) return false;
+		bool stale = connect(probeSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1 && errno == ECONNREFUSED;
+		close(probeSocket);
+		if (!stale) throw std::runtime_error("Another server is already listening on \"" + localSocketPath + "\"!");
+		unlink(localSocketPath.c_str());
+	}
+	localConnectRequestSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (localConnectRequestSocket == -1) return false;
+	// The socket file is created with mode 0600, st. only our user can connect
+	mode_t previousMask = umask(0077);
+	int bindResult = bind(localConnectRequestSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+	umask(previousMask);
+	if (bindResult == -1 || listen(localConnectRequestSocket, SOMAXCONN) == -1) {
+		if (bindResult == 0) unlink(localSocketPath.c_str());
+		close(localConnectRequestSocket);
+		localConnectRequestSocket = -1;
+		return false;
+	}
+	return true;
+}
+
+std::optional<SnackerEngine::SocketTCP> Server::acceptLocalConnectionRequest()
+{
+	int clientSocket = accept4(localConnectRequestSocket, nullptr, nullptr, SOCK_CLOEXEC);
+	if (clientSocket == -1) return {};
+	// SERPEndpoint only needs a connected stream socket, so we can wrap the AF_UNIX socket
+	SnackerEngine::SocketTCP socket;
+	socket.sock = clientSocket;
+	return socket;
+}
+#endif // _LINUX
+
 Server::Server()
-	: printToConsoleMutex{}, clients{}, clientsMapMutex{}, incomingConnectRequestSocket{}, incomingRequestFileDescriptor{}
+	: printToConsoleMutex{}, clients{}, clientsMapMutex{}, incomingConnectRequestSocket{}, incomingRequestFileDescriptors{}
 {
 	// Initialize incomingConnectRequestSocket socket
 	auto result = SnackerEngine::createSocketTCP(SnackerEngine::getSERPServerPort());
 	if (result.has_value()) {
 		incomingConnectRequestSocket = std::move(result.value());
 #ifdef _WINDOWS
-		incomingRequestFileDescriptor = pollfd(incomingConnectRequestSocket.sock, POLLRDNORM, NULL);
+		incomingRequestFileDescriptors.push_back(pollfd(incomingConnectRequestSocket.sock, POLLRDNORM, NULL));
 #endif // _WINDOWS
 #ifdef _LINUX
-		incomingRequestFileDescriptor = pollfd(incomingConnectRequestSocket.sock, POLLRDNORM, 0);
+		incomingRequestFileDescriptors.push_back(pollfd(incomingConnectRequestSocket.sock, POLLRDNORM, 0));
 #endif // _LINUX
 	}
 	else throw std::runtime_error("Could not create incomingConnectRequestSocket!");
 }
 
+void Server::cleanupDisconnectedClients()
+{
+	int numberOfConnectedClients = 0;
+	std::size_t numberOfDisconnectedClients = 0;
+	std::size_t numberOfStuckClients = 0;
+	{
+		std::lock_guard lock(clientsMapMutex);
+		numberOfConnectedClients = static_cast<int>(clients.size());
+		// Try to delete disconnected clients
+		for (auto it = disconnectedClients.begin(); it != disconnectedClients.end();) {
+			if ((*it)->receiverThreadFinished) {
+				it = disconnectedClients.erase(it);
+			}
+			else {
+				it++;
+			}
+		}
+		numberOfDisconnectedClients = disconnectedClients.size();
+		// Clients that stay here for long point to a receiver thread that hangs
+		auto currentTime = std::chrono::steady_clock::now();
+		numberOfStuckClients = static_cast<std::size_t>(std::ranges::count_if(disconnectedClients, [&](const std::shared_ptr<Client>& client) {
+			return currentTime - client->disconnectTime > std::chrono::seconds(stuckClientTimeout);
+		}));
+		// Release SERPIDs whose session has expired
+		std::erase_if(sessions, [&](const auto& session) { return session.second.expiry <= currentTime; });
+	}
+#ifdef _LINUX
+	if (messageStore) messageStore->removeExpired();
+#endif // _LINUX
+	printMessage("Currently " + SnackerEngine::to_string(numberOfConnectedClients) + " clients connected.");
+	if (numberOfDisconnectedClients > 0) {
+		printMessage("Currently " + SnackerEngine::to_string(numberOfDisconnectedClients) + " clients waiting for disconnect.");
+	}
+	if (numberOfStuckClients > 0) {
+		printMessage(SnackerEngine::to_string(numberOfStuckClients) + " disconnected clients have not finished after " + SnackerEngine::to_string(stuckClientTimeout) + " s.");
+	}
+	if (trafficCapture) {
+		// A capture with gaps can't be replayed faithfully, so the user has to know about them
+		uint64_t droppedCaptureMessages = trafficCapture->getDroppedMessages();
+		if (droppedCaptureMessages > reportedDroppedCaptureMessages) {
+			printMessage("The capture dropped " + std::to_string(droppedCaptureMessages - reportedDroppedCaptureMessages) + " messages because the writer could not keep up (" + std::to_string(droppedCaptureMessages) + " in total).");
+			reportedDroppedCaptureMessages = droppedCaptureMessages;
+		}
+	}
+}
+
+#ifdef _IO_URING
+IoThread& Server::chooseIoThread(int numaNode)
+{
+	bool threadOnNode = std::ranges::any_of(ioThreads, [numaNode](const std::unique_ptr<IoThread>& ioThread) { return ioThread->getNumaNode() == numaNode; });
+	IoThread* result = nullptr;
+	for (auto& ioThread : ioThreads) {
+		if (threadOnNode && ioThread->getNumaNode() != numaNode) continue;
+		if (!result || ioThread->getNumberOfClients() < result->getNumberOfClients()) result = ioThread.get();
+	}
+	return *result;
+}
+
+bool Server::handleIoThreadEvent(Client& client, unsigned events)
+{
+	// Messages held back by a connection change come before everything that is still in the socket
+	processHeldMessages(client);
+	if (!client.connected || client.connectionChangePending) return client.connected;
+	if (events & POLLNVAL) {
+		printMessage("Received error POLLNVAL during call to poll() on on client with SERPID" + SnackerEngine::to_string(client.serpID) + "!");
+		disconnectClient(client.serpID);
+		return false;
+	}
+	// I/O threads send with io_uring, which reports zero copy completions as completions and not on the error
+	// queue. We still check, st. a POLLERR without a pending error never drops a healthy client.
+	else if ((events & POLLERR) && client.hasSocketError()) {
+		printMessage("Client with SERPID " + SnackerEngine::to_string(client.serpID) + " disconnected with error.");
+		disconnectClient(client.serpID);
+		return false;
+	}
+	else if (events & POLLHUP) {
+		printMessage("Client with SERPID " + SnackerEngine::to_string(client.serpID) + " disconnected.");
+		disconnectClient(client.serpID);
+		return false;
+	}
+	else if (events & POLLRDNORM) {
+		printMessage("Client with SERPID " + SnackerEngine::to_string(client.serpID) + " has sent a message.");
+		handleIncomingMessage(client);
+	}
+	return client.connected;
+}
+
+bool Server::runAcceptLoopIoUring()
+{
+	std::unique_ptr<IoUring> ring = IoUring::create(ioUringEntries);
+	if (!ring) {
+		printMessage("io_uring is not available, falling back to poll().");
+		return false;
+	}
+	for (std::size_t i = 0; i < incomingRequestFileDescriptors.size(); ++i) {
+		if (!ring->armAccept(incomingRequestFileDescriptors[i].fd, i)) return false;
+	}
+	printMessage("Using io_uring backend.");
+	while (true) {
+		int clientSocket = -1;
+		uint64_t tag = 0;
+		int error = 0;
+		IoUring::WaitResult result = ring->waitForAccept(5000, clientSocket, tag, error);
+		if (result == IoUring::WaitResult::UNSUPPORTED) {
+			printMessage("io_uring does not support multishot accept, falling back to poll().");
+			return false;
+		}
+		else if (result == IoUring::WaitResult::FAILED) {
+			// A single connection failed (or we ran out of file descriptors), the listening socket is fine
+			printMessage("Could not accept connection: " + std::string(strerror(error)));
+		}
+		else if (result == IoUring::WaitResult::ERROR) {
+			throw std::runtime_error(std::string("Error during io_uring accept on incomingRequestFileDescriptor: ") + std::string(strerror(error)));
+		}
+		else if (result == IoUring::WaitResult::SUCCESS) {
+			// Connect new client
+			bool local = tag > 0;
+			SnackerEngine::SocketTCP socket;
+			socket.sock = clientSocket;
+			if (!local) {
+				socklen_t addressLength = sizeof(socket.addr);
+				getpeername(clientSocket, reinterpret_cast<sockaddr*>(&socket.addr), &addressLength);
+			}
+			connectClient(std::move(socket), local);
+		}
+		cleanupDisconnectedClients();
+	}
+}
+
+#endif // _IO_URING
+
+void Server::startCapture(const std::string& path)
+{
+	trafficCapture = std::make_unique<TrafficCapture>(path);
+	printMessage("Capturing received messages to \"" + path + "\".");
+}
+
+void Server::enableRequestTracking(std::chrono::milliseconds timeout)
+{
+	requestTracker = std::make_unique<RequestTracker>(requestTrackerCapacity, timeout);
+	requestTimeoutThreadRunning = true;
+	requestTimeoutThread = std::thread(&Server::runRequestTimeoutThread, this);
+	printMessage("Tracking relayed requests with a timeout of " + SnackerEngine::to_string(timeout.count()) + " ms.");
+}
+
+#ifdef _LINUX
+void Server::enableMessageStore(const std::filesystem::path& directory)
+{
+	// 4 MiB segments, at most 16 MiB per SERPID and 256 MiB in 64 segment files for all SERPIDs together
+	messageStore = std::make_unique<MessageStore>(directory, 4 * 1024 * 1024, 16 * 1024 * 1024, 256 * 1024 * 1024, 64, sessionTimeToLive);
+	printMessage("Storing requests for disconnected clients in \"" + directory.string() + "\".");
+}
+
+bool Server::enableCpuPlacement(const std::string& cpuList)
+{
+	cpuPlacement = CpuPlacement::create(cpuList);
+	if (!cpuPlacement) {
+		printMessage("Invalid CPU list \"" + cpuList + "\".");
+		return false;
+	}
+	printMessage("Pinning server threads to CPUs " + cpuList + ".");
+	return true;
+}
+#endif // _LINUX
+
+void Server::enableMemoryBudget(std::size_t budget)
+{
+	memoryBudget.setBudget(budget);
+	memoryBudgetThreadRunning = true;
+	memoryBudgetThread = std::thread(&Server::runMemoryBudgetThread, this);
+	printMessage("Enforcing a memory budget of " + SnackerEngine::to_string(budget / (1024 * 1024)) + " MiB.");
+}
+
+bool Server::parseCommandLineArguments(int argc, char** argv)
+{
+	for (int i = 1; i < argc; ++i) {
+		std::string argument = argv[i];
+		if (argument == "--capture" && i + 1 < argc) {
+			startCapture(argv[++i]);
+		}
+		else if (argument == "--trackRequests" && i + 1 < argc) {
+			auto timeout = SnackerEngine::from_string<unsigned>(argv[++i]);
+			if (!timeout.has_value()) {
+				printMessage("Invalid timeout \"" + std::string(argv[i]) + "\" for --trackRequests.");
+				return false;
+			}
+			enableRequestTracking(std::chrono::milliseconds(timeout.value()));
+		}
+#ifdef _LINUX
+		else if (argument == "--localSocket" && i + 1 < argc) {
+			// An empty path disables the local socket
+			localSocketPath = argv[++i];
+		}
+		else if (argument == "--storeDirectory" && i + 1 < argc) {
+			enableMessageStore(argv[++i]);
+		}
+		else if (argument == "--cpus" && i + 1 < argc) {
+			if (!enableCpuPlacement(argv[++i])) return false;
+		}
+#endif // _LINUX
+		else if (argument == "--memoryBudget" && i + 1 < argc) {
+			auto megabytes = SnackerEngine::from_string<unsigned>(argv[++i]);
+			if (!megabytes.has_value() || megabytes.value() == 0) {
+				printMessage("Invalid memory budget \"" + std::string(argv[i]) + "\" (expected MiB).");
+				return false;
+			}
+			enableMemoryBudget(static_cast<std::size_t>(megabytes.value()) * 1024 * 1024);
+		}
+		else if (argument == "--workers" && i + 1 < argc) {
+			auto workers = SnackerEngine::from_string<unsigned>(argv[++i]);
+			if (!workers.has_value()) {
+				printMessage("Invalid number of workers \"" + std::string(argv[i]) + "\".");
+				return false;
+			}
+			numberOfWorkers = workers.value();
+		}
+#ifdef _IO_URING
+		else if (argument == "--ioThreads" && i + 1 < argc) {
+			auto threads = SnackerEngine::from_string<unsigned>(argv[++i]);
+			if (!threads.has_value()) {
+				printMessage("Invalid number of I/O threads \"" + std::string(argv[i]) + "\".");
+				return false;
+			}
+			numberOfIoThreads = threads.value();
+		}
+#endif // _IO_URING
+		else if (argument == "--socketProfile" && i + 1 < argc) {
+			auto profile = getSocketProfile(argv[++i]);
+			if (!profile.has_value()) {
+				printMessage("Unknown socket profile \"" + std::string(argv[i]) + "\". Valid profiles are interactive, bulk and system.");
+				return false;
+			}
+			socketProfile = profile.value();
+		}
+		else {
+			printMessage("Invalid command line argument \"" + argument + "\".");
+			return false;
+		}
+	}
+	return true;
+}
+
 void Server::run()
 {
 	if (!SnackerEngine::markAsListen(incomingConnectRequestSocket)) throw std::runtime_error("Could not mark incomingConnectRequestSocket as listening!");
+#ifdef _LINUX
+	// Initialize local socket (after the command line arguments were applied). The server still works without it.
+	if (!localSocketPath.empty()) {
+		if (createLocalSocket()) incomingRequestFileDescriptors.push_back(pollfd(localConnectRequestSocket, POLLRDNORM, 0));
+		else printMessage("Could not create local socket at \"" + localSocketPath + "\": " + std::string(strerror(errno)));
+	}
+#endif // _LINUX
 	printMessage("Started Server!");
+#ifdef _LINUX
+	// The accepting thread may run on any of the configured CPUs
+	if (cpuPlacement) cpuPlacement->pinCurrentThread();
+#endif // _LINUX
+	if (numberOfWorkers > 0) {
+		workerPool = std::make_unique<WorkerPool>(numberOfWorkers, [this](std::size_t) {
+#ifdef _LINUX
+			if (cpuPlacement) cpuPlacement->pinCurrentThread();
+#endif // _LINUX
+		});
+	}
+#ifdef _IO_URING
+	for (unsigned i = 0; i < numberOfIoThreads; ++i) {
+		// The threads are spread over the nodes in turn, st. every node gets one before any gets a second
+		int numaNode = -1;
+#ifdef _LINUX
+		if (cpuPlacement) numaNode = static_cast<int>(i % cpuPlacement->getNumberOfNodes());
+#endif // _LINUX
+		std::unique_ptr<IoThread> ioThread = IoThread::create(ioUringEntries,
+			[this](Client& client, unsigned events) { return handleIoThreadEvent(client, events); },
+			[this, numaNode]() {
+#ifdef _LINUX
+				if (cpuPlacement) cpuPlacement->pinCurrentThread(numaNode);
+#endif // _LINUX
+			}, memoryPauseInterval, numaNode);
+		if (!ioThread) {
+			printMessage("io_uring does not support the operations of the I/O threads, every client gets its own threads.");
+			ioThreads.clear();
+			break;
+		}
+		ioThreads.push_back(std::move(ioThread));
+	}
+	if (!ioThreads.empty()) printMessage("Serving remote clients from " + SnackerEngine::to_string(ioThreads.size()) + " I/O threads.");
+	if (runAcceptLoopIoUring()) return;
+#endif // _IO_URING
 	while (true) {
 		// First process events
 #ifdef _WINDOWS
-		int result = WSAPoll(&incomingRequestFileDescriptor, 1, 5000);
+		int result = WSAPoll(incomingRequestFileDescriptors.data(), static_cast<ULONG>(incomingRequestFileDescriptors.size()), 5000);
 		if (result == SOCKET_ERROR) throw std::runtime_error(std::string("Socket error with error code " + std::to_string(WSAGetLastError()) + " occured during call to poll()!"));
-		if (incomingRequestFileDescriptor.revents != NULL) {
 #endif // _WINDOWS
 #ifdef _LINUX
-		int result = poll(&incomingRequestFileDescriptor, 1, 5000);
+		int result = poll(incomingRequestFileDescriptors.data(), incomingRequestFileDescriptors.size(), 5000);
 		if (result == -1) throw std::runtime_error(std::string("Socket error with error code ") + std::string(strerror(errno)) + std::string(" occured during call to poll()!"));
-		if (incomingRequestFileDescriptor.revents != 0) {
 #endif // _LINUX
+		for (std::size_t i = 0; i < incomingRequestFileDescriptors.size(); ++i) {
+			const pollfd& incomingRequestFileDescriptor = incomingRequestFileDescriptors[i];
 			if (incomingRequestFileDescriptor.revents & POLLRDNORM) {
 				// Connect new client
-				std::optional<SnackerEngine::SocketTCP> clientSocket = SnackerEngine::acceptConnectionRequest(incomingConnectRequestSocket);
+				bool local = i > 0;
+				std::optional<SnackerEngine::SocketTCP> clientSocket{};
+				if (!local) clientSocket = SnackerEngine::acceptConnectionRequest(incomingConnectRequestSocket);
+#ifdef _LINUX
+				else clientSocket = acceptLocalConnectionRequest();
+#endif // _LINUX
 				if (clientSocket.has_value()) {
-					connectClient(std::move(clientSocket.value()));
+					connectClient(std::move(clientSocket.value()), local);
 				}
 			}
 			else if (incomingRequestFileDescriptor.revents & POLLERR) {
@@ -353,28 +1341,47 @@ void Server::run()
 				throw std::runtime_error(std::string("POLLHUP in incomingRequestFileDescriptor."));
 			}
 		}
-		int numberOfConnectedClients = 0;
-		{
-			std::lock_guard lock(clientsMapMutex);
-			numberOfConnectedClients = static_cast<int>(clients.size());
-		}
-		// Try to delete disconnected clients
-		for (auto it = disconnectedClients.begin(); it != disconnectedClients.end();) {
-			if ((*it)->receiverThreadFinished) {
-				it = disconnectedClients.erase(it);
-			}
-			else {
-				it++;
-			}
-		}
-		printMessage("Currently " + SnackerEngine::to_string(numberOfConnectedClients) + " clients connected.");
-		if (!disconnectedClients.empty()) {
-			printMessage("Currently " + SnackerEngine::to_string(disconnectedClients.size()) + " clients waiting for disconnect.");
-		}
+		cleanupDisconnectedClients();
 	}
 }
 
 Server::~Server()
 {
-	// TODO: Write destructor.
+	// Disconnect all clients. Their receiver threads and the I/O threads call back into the server.
+	std::vector<SnackerEngine::SERPID> connectedClients;
+	{
+		std::lock_guard lockGuard(clientsMapMutex);
+		for (auto& client : clients) connectedClients.push_back(client.second->serpID);
+	}
+	for (SnackerEngine::SERPID serpID : connectedClients) disconnectClient(serpID);
+	std::vector<std::shared_ptr<Client>> remainingClients;
+	{
+		std::lock_guard lockGuard(clientsMapMutex);
+		remainingClients = disconnectedClients;
+	}
+	for (auto& client : remainingClients) {
+		if (client->receiverThread.joinable()) client->receiverThread.join();
+	}
+#ifdef _IO_URING
+	for (auto& ioThread : ioThreads) ioThread->waitForRemovedClients();
+#endif // _IO_URING
+	if (memoryBudgetThread.joinable()) {
+		memoryBudgetThreadRunning = false;
+		memoryBudgetThread.join();
+	}
+	if (requestTimeoutThread.joinable()) {
+		requestTimeoutThreadRunning = false;
+		requestTimeoutThread.join();
+	}
+	// Queued tasks still use the server and may notify the I/O threads, finish them first
+	workerPool = nullptr;
+#ifdef _IO_URING
+	ioThreads.clear();
+#endif // _IO_URING
+#ifdef _LINUX
+	if (localConnectRequestSocket != -1) {
+		close(localConnectRequestSocket);
+		unlink(localSocketPath.c_str());
+	}
+#endif // _LINUX
 }
@@ -1,6 +1,15 @@
 #pragma once
 #include "Client.h"
+#include "MessageStore.h"
+#include "TrafficCapture.h"
+#include "RequestTracker.h"
+#include "Compression.h"
+#include "CpuPlacement.h"
+#include "WorkerPool.h"
+#include "MemoryBudget.h"
+#include "IoThread.h"
 #include <unordered_map>
+#include <random>
 
 class Server 
 {
@@ -11,11 +20,30 @@ private:
 	unsigned numberOfRetriesSerpID = 10;
 	/// Mutex for printing to console
 	std::mutex printToConsoleMutex;
+	/// Memory held for all clients. Declared before the clients, st. it outlives their queued messages.
+	MemoryBudget memoryBudget;
+	/// Interval in ms in which the memory budget thread enforces the budget
+	unsigned memoryBudgetCheckInterval = 50;
+	/// Interval in ms in which a paused receiver thread checks whether it may read again
+	unsigned memoryPauseInterval = 10;
+	/// Thread that enforces the memory budget, and a flag to stop it
+	std::thread memoryBudgetThread;
+	std::atomic<bool> memoryBudgetThreadRunning = false;
+	/// Function run by the memory budget thread
+	void runMemoryBudgetThread();
+	/// Thread safe helper function that returns the memory accounts of all connected clients
+	std::vector<std::pair<SnackerEngine::SERPID, std::shared_ptr<MemoryAccount>>> getMemoryAccounts();
+	/// Helper function that answers a request for the memory statistics
+	void answerMemoryStatisticsRequest(Client& client, const SnackerEngine::SERPRequest& request);
 	/// Map of connected clients, with mutex for thread safe access
 	std::unordered_map<unsigned, std::shared_ptr<Client>> clients;
 	std::mutex clientsMapMutex;
 	/// Vector of disconnected clients where the receiver thread hasn't yet ended
 	std::vector<std::shared_ptr<Client>> disconnectedClients;
+	/// Time in s after which a disconnected client whose receiver thread hasn't ended is reported as stuck
+	unsigned stuckClientTimeout = 30;
+	/// Helper function that answers a request for the resource usage of the server (memory, threads, client objects)
+	void answerResourceStatisticsRequest(Client& client, const SnackerEngine::SERPRequest& request);
 	/// Thread safe helper function for writing messages to the console/output
 	void printMessage(const std::string& message);
 	/// Thread safe helper function that looks for a client with the given SerpID and returns a shared pointer to the client
@@ -23,10 +51,61 @@ private:
 	std::shared_ptr<Client> getClient(SnackerEngine::SERPID serpID);
 	/// Socket for accepting incoming requests
 	SnackerEngine::SocketTCP incomingConnectRequestSocket;
-	/// File descriptor for incoming requests
-	pollfd incomingRequestFileDescriptor;
+	/// File descriptors for incoming requests. The first one belongs to incomingConnectRequestSocket,
+	/// the second one (linux only) to the local AF_UNIX socket.
+	std::vector<pollfd> incomingRequestFileDescriptors;
+#ifdef _LINUX
+	/// Path of the local AF_UNIX socket for clients running on the same host. Empty to disable.
+	std::string localSocketPath = "/tmp/serp.sock";
+	/// Socket for accepting incoming requests from clients on the same host (or -1)
+	int localConnectRequestSocket = -1;
+	/// Helper function that creates the local AF_UNIX socket and starts listening on it. Only the user
+	/// of the server can connect to it. Throws if another server is listening on the path already.
+	bool createLocalSocket();
+	/// Capacity in bytes of each ring of the shared memory segments created for local clients
+	uint64_t sharedMemoryRingCapacity = 1 << 20;
+	/// Helper function that accepts a connection on the local socket
+	std::optional<SnackerEngine::SocketTCP> acceptLocalConnectionRequest();
+	/// Helper function that creates a shared memory segment for a local client and tells it the name
+	void answerSharedMemoryRequest(Client& client, const SnackerEngine::SERPRequest& request);
+	/// Optional placement of server threads on a set of CPUs (nullptr if threads are not pinned)
+	std::unique_ptr<CpuPlacement> cpuPlacement;
+	/// Helper function that answers a request for the thread placement statistics
+	void answerThreadStatisticsRequest(Client& client, const SnackerEngine::SERPRequest& request);
+#endif // _LINUX
+	/// Session of a SERPID. After a reconnect, a client can reclaim its old SERPID by presenting the token.
+	struct Session
+	{
+		uint64_t token;
+		/// Time at which the SERPID is released again. Is time_point::max() while the client is connected.
+		std::chrono::steady_clock::time_point expiry;
+	};
+	/// Sessions by SERPID, guarded by clientsMapMutex. SERPIDs with a session are not given to new clients.
+	std::unordered_map<unsigned, Session> sessions;
+	/// Random number generator for session tokens, guarded by clientsMapMutex
+	std::mt19937_64 sessionTokenGenerator{ std::random_device{}() };
+	/// Helper function that issues a session token for the SERPID of the given client
+	void answerSessionTokenRequest(Client& client, const SnackerEngine::SERPRequest& request);
+	/// Helper function that gives a previous SERPID back to a reconnected client and replays stored messages
+	void answerReclaimRequest(Client& client, const SnackerEngine::SERPRequest& request, const std::string& requestedClient);
+	/// Time a SERPID with a session stays reserved after its client disconnected
+	std::chrono::milliseconds sessionTimeToLive = std::chrono::minutes(10);
+#ifdef _LINUX
+	/// Optional store for requests whose destination is not connected (nullptr if the store is disabled)
+	std::unique_ptr<MessageStore> messageStore;
+	/// Helper function that answers a request that turns store-and-forward on or off for the given client
+	void answerStoreAndForwardRequest(Client& client, const SnackerEngine::SERPRequest& request);
+#endif // _LINUX
+	/// Helper function that handles a request whose destination is not connected. Requests of clients that
+	/// turned on store-and-forward are stored if the destination has a session, all others (or if storing
+	/// fails) are answered with NOT_FOUND. The request itself is not modified, decoded is passed on to
+	/// adaptCompression().
+	void handleUndeliverableRequest(Client& source, SnackerEngine::SERPID destination, const SnackerEngine::SERPMessage& request, std::optional<SnackerEngine::Buffer>* decoded = nullptr);
+	/// Socket options applied to every accepted connection
+	SocketProfile socketProfile{};
 	/// Thread safe helper function for connecting a new client and assigning a new serpID.
-	void connectClient(SnackerEngine::SocketTCP socket);
+	/// Local clients connected through the AF_UNIX socket and are not checked for duplicate addresses.
+	void connectClient(SnackerEngine::SocketTCP socket, bool local = false);
 	/// Thread safe helper function for removing a client from the clients map
 	void disconnectClient(SnackerEngine::SERPID serpID);
 	/// Helper function that sends the given response to the given client (by putting it in the appropriate queue. The
@@ -34,6 +113,16 @@ private:
 	void sendMessageResponse(const SnackerEngine::SERPRequest& request, Client& client, SnackerEngine::ResponseStatusCode responseStatusCode, const std::string& message, SnackerEngine::SERPID sourceID = SnackerEngine::SERPID::SERVER_ID);
 	/// Helper function that prepares a message for relay. Returns false if the message is in any way invalid.
 	bool prepareForRelay(const SnackerEngine::SERPMessage& message, Client& source);
+	/// Maximal size of a decompressed message body
+	std::size_t maxDecompressedSize = 64 * 1024 * 1024;
+	/// Helper function that negotiates the compression codec of the given client
+	void answerCompressionRequest(Client& client, const SnackerEngine::SERPRequest& request);
+	/// Makes sure the receiver can read the body of the given message. Only sources that negotiated a codec
+	/// send framed bodies (see Compression.h). A frame is relayed as it is if the destination negotiated its
+	/// codec, and decoded otherwise (destination nullptr means the server itself). Plain bodies that look like
+	/// a frame are escaped for destinations that negotiated a codec. If decoded is given, it caches the decoded
+	/// body across the destinations of one message. Returns false if the body could not be decoded.
+	bool adaptCompression(SnackerEngine::SERPMessage& message, CompressionCodec sourceCodec, const Client* destination, std::optional<SnackerEngine::Buffer>* decoded = nullptr);
 	/// Helper function that trys to relay a request from client to client.
 	void relayRequest(Client& source, SnackerEngine::SERPID destination, std::unique_ptr<SnackerEngine::SERPMessage> request);
 	/// Relays the HTTP request from the source client to the multiple destination clients (destinations clients stored in )
@@ -42,19 +131,115 @@ private:
 	void relayResponse(Client& source, SnackerEngine::SERPID destination, std::unique_ptr<SnackerEngine::SERPMessage> response);
 	/// Helper function that answers a request from a client that asks if another client exists.
 	void answerClientExistsRequest(Client& client, const SnackerEngine::SERPRequest& request, const std::string& requestedClient);
+	/// Maximal number of SERPIDs in a single presence request
+	std::size_t maxPresenceQuerySize = 65536;
+	/// Helper function that answers a request from a client that asks which of a list of clients are connected.
+	/// The body contains the SERPIDs separated by commas. The response body is a bitmap with one bit per
+	/// requested SERPID (bit i is bit i % 8 of byte i / 8), which is set if the client is connected.
+	void answerPresenceRequest(Client& client, const SnackerEngine::SERPRequest& request);
+	/// Number of worker threads that handle requests to the server (0 handles them on the receiver threads)
+	unsigned numberOfWorkers = 2;
+	/// Pool of worker threads that handle requests to the server, st. the receiver threads only parse and relay
+	std::unique_ptr<WorkerPool> workerPool;
+	/// Helper function that answers a request for the worker pool statistics
+	void answerWorkerStatisticsRequest(Client& client, const SnackerEngine::SERPRequest& request);
+	/// Helper function that hands a request to the server to the worker pool. Requests that change the
+	/// connection itself (reclaim, sharedMemory) are queued like all others, but the messages of the client
+	/// are held back until they were handled (see Client::connectionChangePending).
+	void dispatchRequestToServer(Client& client, std::unique_ptr<SnackerEngine::SERPMessage> request);
+	/// Helper function that queues a task for the given client. The tasks of a client run one after another
+	/// on the worker pool, in the order they were queued.
+	void submitServerRequest(std::shared_ptr<Client> client, std::function<void()> task);
+	/// Helper function that runs the queued tasks of the given client until its queue is empty
+	void runServerRequests(Client& client);
+	/// Number of clients a single worker task enqueues a broadcast for
+	std::size_t broadcastChunkSize = 256;
+	/// Helper function that relays a POST request with the target "broadcast/<target>" to all other connected
+	/// clients. The request is serialized only once and all send queues share the serialized message, so every
+	/// receiver gets the same header: the target is <target>, the source is the sender and the destination is
+	/// the server, not the receiver itself. Receivers answer to the source as for any other request.
+	void answerBroadcastRequest(Client& client, SnackerEngine::SERPRequest& request, const std::vector<std::string>& path);
+	/// Helper function that sends all stored messages for the SERPID of the given client to it
+	void replayStoredMessages(Client& client);
 	/// Helper function that handles an incoming request to the server (thats us!)
-	void handleIncomingRequestToServer(Client& client, std::unique_ptr<SnackerEngine::SERPMessage> request);
+	void handleIncomingRequestToServer(Client& client, SnackerEngine::SERPMessage& request);
 	/// Helper function that handles an incoming request from the given client
 	void handleIncomingRequest(Client& client, std::unique_ptr<SnackerEngine::SERPMessage> request);
+	/// Optional tracking of relayed requests that still wait for a response (nullptr if tracking is disabled)
+	std::unique_ptr<RequestTracker> requestTracker;
+	/// Number of requests that can be tracked at the same time
+	std::size_t requestTrackerCapacity = 1 << 16;
+	/// Interval in ms in which the request timeout thread checks for timed out requests
+	unsigned requestTimeoutCheckInterval = 100;
+	/// Thread that answers timed out requests, and a flag to stop it
+	std::thread requestTimeoutThread;
+	std::atomic<bool> requestTimeoutThreadRunning = false;
+	/// Function run by the request timeout thread
+	void runRequestTimeoutThread();
+	/// Helper function that answers a request for the response time statistics
+	void answerLatencyStatisticsRequest(Client& client, const SnackerEngine::SERPRequest& request);
+	/// Optional capture of all received messages (nullptr if capturing is disabled)
+	std::unique_ptr<TrafficCapture> trafficCapture;
+	/// Number of dropped capture messages that were already reported in the log (only used by the accepting thread)
+	uint64_t reportedDroppedCaptureMessages = 0;
+	/// Helper function that answers a request for the capture statistics
+	void answerCaptureStatisticsRequest(Client& client, const SnackerEngine::SERPRequest& request);
 	/// Helper function that handles an incoming response from the given client
 	void handleIncomingResponse(Client& client, std::unique_ptr<SnackerEngine::SERPMessage> response);
+	/// Helper function that relays/answers the given messages received from a client.
+	void handleIncomingMessages(Client& client, std::vector<std::unique_ptr<SnackerEngine::SERPMessage>>& messages);
+	/// Helper function that relays/answers the given messages. Once a request changes the connection, the
+	/// remaining messages are moved to the held messages of the client.
+	void processIncomingMessages(Client& client, std::vector<std::unique_ptr<SnackerEngine::SERPMessage>>& messages);
+	/// Helper function that relays/answers the messages held back by a connection change. Called by the thread
+	/// that receives the messages of the client, before it reads from the socket again.
+	void processHeldMessages(Client& client);
 	/// Helper function that receives a message from a client and relays/answers the message.
 	void handleIncomingMessage(Client& client);
 	/// Helper function that runs a receiver thread on the given client, listening for messages and relaying/answering them.
 	void runReceiverThread(std::shared_ptr<Client> client);
+	/// Helper function that deletes disconnected clients whose receiver thread has finished and prints the current status
+	void cleanupDisconnectedClients();
+#ifdef _IO_URING
+	/// Number of submission queue entries of each io_uring instance
+	unsigned ioUringEntries = 256;
+	/// Number of I/O threads that serve the remote clients. With 0, every client gets its own sender and
+	/// receiver thread. Local clients always get their own threads (they can switch to shared memory).
+	unsigned numberOfIoThreads = 2;
+	/// The I/O threads. With CPU placement, they are spread over the NUMA nodes and each is pinned to one node.
+	std::vector<std::unique_ptr<IoThread>> ioThreads;
+	/// Helper function that chooses the I/O thread for a new remote client: the thread with the fewest clients
+	/// among the threads on the given NUMA node, or among all threads if no thread runs on that node.
+	IoThread& chooseIoThread(int numaNode);
+	/// Called by an I/O thread when poll reported the given events on the socket of the client. Returns
+	/// false if the client was disconnected.
+	bool handleIoThreadEvent(Client& client, unsigned events);
+	/// Runs the main loop using io_uring multishot accepts. Returns false if io_uring is not supported
+	/// by the kernel, in which case the poll() loop is used.
+	bool runAcceptLoopIoUring();
+#endif // _IO_URING
 public:
 	/// Constructor
 	Server();
+	/// Starts capturing all received messages into the given file. Must be called before run().
+	void startCapture(const std::string& path);
+	/// Enables tracking of relayed requests. Requests that are not answered within the given timeout are
+	/// answered by the server. Must be called before run().
+	void enableRequestTracking(std::chrono::milliseconds timeout);
+#ifdef _LINUX
+	/// Enables the message store with segment files in the given directory, which should be owned by the
+	/// user of the server. The store only deletes the files it created, and stored messages are lost when
+	/// the server stops (see MessageStore). Must be called before run().
+	void enableMessageStore(const std::filesystem::path& directory);
+	/// Pins all server threads to the given CPUs (eg. "0-7,16-23"). The threads of each client, or the I/O thread
+	/// that serves it, are placed on the NUMA node that receives its packets. Must be called before run().
+	/// Returns false if the list is invalid.
+	bool enableCpuPlacement(const std::string& cpuList);
+#endif // _LINUX
+	/// Enforces a budget (in bytes) for the memory held for all clients. Must be called before run().
+	void enableMemoryBudget(std::size_t budget);
+	/// Applies the given command line arguments (see main.cpp). Returns false on invalid arguments.
+	bool parseCommandLineArguments(int argc, char** argv);
 	/// Runs the main loop, listening for connection requests and invoking new threads for connected clients.
 	void run();
 	/// Destructor
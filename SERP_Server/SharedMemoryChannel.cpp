@@ -0,0 +1,264 @@
+#include "SharedMemoryChannel.h"
+
+#ifdef _LINUX
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <chrono>
+#include <random>
+
+namespace
+{
+	/// Size of the length prefix of each record
+	constexpr uint64_t recordHeaderSize = sizeof(uint32_t);
+
+	/// Records are padded to 8 bytes st. length prefixes are always aligned
+	uint64_t alignRecord(uint64_t size)
+	{
+		return (size + 7) & ~uint64_t(7);
+	}
+
+	/// Waits on the given futex word as long as it has the expected value. The segment is shared
+	/// between processes, so we cannot use the private futex operations.
+	void futexWait(std::atomic<uint32_t>& word, uint32_t expected, int timeoutMs)
+	{
+		timespec timeout{ timeoutMs / 1000, (timeoutMs % 1000) * 1000000L };
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, timeoutMs < 0 ? nullptr : &timeout, nullptr, 0);
+	}
+
+	/// Wakes all waiters on the given futex word
+	void futexWake(std::atomic<uint32_t>& word)
+	{
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+	}
+
+	/// Segment names are chosen by the server. We only accept names in our own namespace.
+	bool isValidSegmentName(const std::string& name)
+	{
+		if (name.size() < 7 || name.size() > NAME_MAX || name.rfind("/serp-", 0) != 0) return false;
+		return name.find('/', 1) == std::string::npos;
+	}
+
+	/// Returns a new segment name with 128 random bits, st. other processes cannot guess it
+	std::string generateSegmentName()
+	{
+		static constexpr char digits[] = "0123456789abcdef";
+		std::random_device randomDevice;
+		std::string name = "/serp-";
+		for (int i = 0; i < 4; ++i) {
+			uint32_t value = randomDevice();
+			for (int j = 0; j < 8; ++j, value >>= 4) name.push_back(digits[value & 0xF]);
+		}
+		return name;
+	}
+}
+
+void SharedMemoryChannel::copyToRing(std::byte* data, uint64_t position, const std::byte* source, std::size_t size) const
+{
+	uint64_t offset = position & (ringCapacity - 1);
+	std::size_t firstPart = std::min<std::size_t>(size, ringCapacity - offset);
+	std::memcpy(data + offset, source, firstPart);
+	if (firstPart < size) std::memcpy(data, source + firstPart, size - firstPart);
+}
+
+void SharedMemoryChannel::copyFromRing(const std::byte* data, uint64_t position, std::byte* destination, std::size_t size) const
+{
+	uint64_t offset = position & (ringCapacity - 1);
+	std::size_t firstPart = std::min<std::size_t>(size, ringCapacity - offset);
+	std::memcpy(destination, data + offset, firstPart);
+	if (firstPart < size) std::memcpy(destination + firstPart, data, size - firstPart);
+}
+
+void SharedMemoryChannel::notifyConsumer()
+{
+	outgoing->writeSequence.fetch_add(1, std::memory_order_release);
+	// Only do a syscall if the consumer is actually sleeping
+	if (outgoing->readerWaiting.exchange(0)) futexWake(outgoing->writeSequence);
+}
+
+bool SharedMemoryChannel::pushRecord(const std::byte* data, uint32_t size, int timeoutMs)
+{
+	uint64_t needed = alignRecord(recordHeaderSize + size);
+	if (needed > ringCapacity) return false;
+	// The tail is written by the peer. If it is ahead of our head, the ring is corrupted and we treat it as full.
+	auto freeSpace = [&]() -> uint64_t {
+		uint64_t used = outgoingHead - outgoing->tail.load(std::memory_order_acquire);
+		return used > ringCapacity ? 0 : ringCapacity - used;
+	};
+	// Wait until the consumer has freed enough space. Futex waits can return early, so we wait until the deadline.
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+	while (freeSpace() < needed) {
+		int remainingMs = static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count());
+		if (remainingMs <= 0) return false;
+		uint32_t sequence = outgoing->readSequence.load(std::memory_order_acquire);
+		outgoing->writerWaiting.store(1);
+		if (freeSpace() >= needed) break;
+		futexWait(outgoing->readSequence, sequence, remainingMs);
+	}
+	copyToRing(outgoingData, outgoingHead, reinterpret_cast<const std::byte*>(&size), recordHeaderSize);
+	copyToRing(outgoingData, outgoingHead + recordHeaderSize, data, size);
+	outgoingHead += needed;
+	outgoing->head.store(outgoingHead);
+	notifyConsumer();
+	return true;
+}
+
+std::unique_ptr<SharedMemoryChannel> SharedMemoryChannel::create(uint64_t ringCapacity, uid_t peerUid)
+{
+	if (ringCapacity == 0 || (ringCapacity & (ringCapacity - 1)) != 0) return nullptr;
+	std::string name = generateSegmentName();
+	int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (fd == -1) return nullptr;
+	std::size_t size = sizeof(SharedMemorySegmentHeader) + 2 * ringCapacity;
+	// A client of another user can only open the segment if it belongs to that user
+	if ((peerUid != geteuid() && fchown(fd, peerUid, static_cast<gid_t>(-1)) == -1) || ftruncate(fd, static_cast<off_t>(size)) == -1) {
+		close(fd);
+		shm_unlink(name.c_str());
+		return nullptr;
+	}
+	void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		shm_unlink(name.c_str());
+		return nullptr;
+	}
+	std::unique_ptr<SharedMemoryChannel> channel(new SharedMemoryChannel());
+	channel->segment = static_cast<SharedMemorySegmentHeader*>(mapping);
+	channel->mappingSize = size;
+	channel->ringCapacity = ringCapacity;
+	channel->name = name;
+	channel->owner = true;
+	// The memory is zero initialized by ftruncate, we only have to set the constant fields
+	channel->segment->magic = magic;
+	channel->segment->version = version;
+	channel->segment->ringCapacity = ringCapacity;
+	std::byte* data = static_cast<std::byte*>(mapping) + sizeof(SharedMemorySegmentHeader);
+	channel->outgoing = &channel->segment->serverToClient;
+	channel->outgoingData = data + ringCapacity;
+	channel->incoming = &channel->segment->clientToServer;
+	channel->incomingData = data;
+	return channel;
+}
+
+std::unique_ptr<SharedMemoryChannel> SharedMemoryChannel::attach(const std::string& name)
+{
+	if (!isValidSegmentName(name)) return nullptr;
+	int fd = shm_open(name.c_str(), O_RDWR, 0);
+	if (fd == -1) return nullptr;
+	struct stat fileStatus {};
+	if (fstat(fd, &fileStatus) == -1 || static_cast<std::size_t>(fileStatus.st_size) < sizeof(SharedMemorySegmentHeader)) {
+		close(fd);
+		return nullptr;
+	}
+	std::size_t size = static_cast<std::size_t>(fileStatus.st_size);
+	void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) return nullptr;
+	std::unique_ptr<SharedMemoryChannel> channel(new SharedMemoryChannel());
+	channel->segment = static_cast<SharedMemorySegmentHeader*>(mapping);
+	channel->mappingSize = size;
+	channel->name = name;
+	// Validate the segment once and keep our own copy of the capacity
+	uint64_t ringCapacity = channel->segment->ringCapacity;
+	if (channel->segment->magic != magic || channel->segment->version != version ||
+		ringCapacity == 0 || (ringCapacity & (ringCapacity - 1)) != 0 ||
+		sizeof(SharedMemorySegmentHeader) + 2 * ringCapacity != size) {
+		return nullptr;
+	}
+	channel->ringCapacity = ringCapacity;
+	std::byte* data = static_cast<std::byte*>(mapping) + sizeof(SharedMemorySegmentHeader);
+	channel->outgoing = &channel->segment->clientToServer;
+	channel->outgoingData = data;
+	channel->incoming = &channel->segment->serverToClient;
+	channel->incomingData = data + ringCapacity;
+	channel->outgoingHead = channel->outgoing->head.load();
+	channel->incomingTail = channel->incoming->tail.load();
+	return channel;
+}
+
+bool SharedMemoryChannel::fits(std::size_t size) const
+{
+	return alignRecord(recordHeaderSize + size) <= ringCapacity;
+}
+
+bool SharedMemoryChannel::sendMessage(SnackerEngine::SERPMessage& message, int timeoutMs)
+{
+	return sendSerializedMessage(message.serialize(), timeoutMs);
+}
+
+bool SharedMemoryChannel::sendSerializedMessage(const SnackerEngine::Buffer& serialized, int timeoutMs)
+{
+	if (serialized.size() == 0 || !fits(serialized.size())) return false;
+	return pushRecord(serialized.data(), static_cast<uint32_t>(serialized.size()), timeoutMs);
+}
+
+void SharedMemoryChannel::ringDoorbell()
+{
+	// The doorbell is a flag and not a record, st. it does not need space in the ring
+	outgoing->doorbell.store(1, std::memory_order_release);
+	notifyConsumer();
+}
+
+std::optional<std::vector<std::unique_ptr<SnackerEngine::SERPMessage>>> SharedMemoryChannel::receiveMessages(int timeoutMs, bool& doorbell)
+{
+	std::vector<std::unique_ptr<SnackerEngine::SERPMessage>> messages;
+	uint64_t head = incoming->head.load(std::memory_order_acquire);
+	// Futex waits can return early (eg. for the sequence increment of a record we already read), so we wait until the deadline
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+	while (head == incomingTail && !incoming->doorbell.load()) {
+		int remainingMs = static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count());
+		if (remainingMs <= 0) break;
+		// Nothing to read. Announce that we are going to sleep and check again before actually sleeping.
+		uint32_t sequence = incoming->writeSequence.load(std::memory_order_acquire);
+		incoming->readerWaiting.store(1);
+		head = incoming->head.load();
+		if (head == incomingTail && !incoming->doorbell.load()) {
+			futexWait(incoming->writeSequence, sequence, remainingMs);
+			head = incoming->head.load(std::memory_order_acquire);
+		}
+		incoming->readerWaiting.store(0);
+	}
+	doorbell = incoming->doorbell.exchange(0, std::memory_order_acq_rel) != 0;
+	// The head is written by the peer, never read more than the ring holds
+	if (head - incomingTail > ringCapacity) return {};
+	uint64_t tail = incomingTail;
+	while (tail != head) {
+		uint32_t size = 0;
+		copyFromRing(incomingData, tail, reinterpret_cast<std::byte*>(&size), recordHeaderSize);
+		uint64_t recordSize = alignRecord(recordHeaderSize + size);
+		if (size == 0 || recordSize > head - tail) return {};
+		SnackerEngine::Buffer buffer(static_cast<std::size_t>(size));
+		copyFromRing(incomingData, tail + recordHeaderSize, buffer.data(), size);
+		std::unique_ptr<SnackerEngine::SERPMessage> message = SnackerEngine::SERPMessage::parse(buffer.getBufferView());
+		if (!message) return {};
+		messages.push_back(std::move(message));
+		tail += recordSize;
+	}
+	if (tail == incomingTail) return messages;
+	// The peer has mapped the segment, nobody else needs to find it anymore
+	if (owner) {
+		shm_unlink(name.c_str());
+		owner = false;
+	}
+	// Release the space to the producer and wake it up if it is waiting for space
+	incomingTail = tail;
+	incoming->tail.store(tail);
+	incoming->readSequence.fetch_add(1, std::memory_order_release);
+	if (incoming->writerWaiting.exchange(0)) futexWake(incoming->readSequence);
+	return messages;
+}
+
+SharedMemoryChannel::~SharedMemoryChannel()
+{
+	if (segment) munmap(segment, mappingSize);
+	if (owner) shm_unlink(name.c_str());
+}
+
+#endif // _LINUX
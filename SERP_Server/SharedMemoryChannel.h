@@ -0,0 +1,113 @@
+#pragma once
+#include "Network/SERP/SERPEndpoint.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#ifdef _LINUX
+	#include <sys/types.h>
+#endif // _LINUX
+
+#ifdef _LINUX
+
+/// Layout of a single ring inside the shared memory segment. Each ring has exactly one
+/// producer and one consumer. head and tail are monotonically increasing byte offsets.
+/// The sequence counters are used as futex words for waiting on new data/free space. The doorbell
+/// is set by the producer to tell the consumer that a message was sent over the socket instead.
+struct SharedMemoryRingHeader
+{
+	alignas(64) std::atomic<uint64_t> head;
+	std::atomic<uint32_t> writeSequence;
+	std::atomic<uint32_t> readerWaiting;
+	std::atomic<uint32_t> doorbell;
+	alignas(64) std::atomic<uint64_t> tail;
+	std::atomic<uint32_t> readSequence;
+	std::atomic<uint32_t> writerWaiting;
+};
+
+/// Layout of the beginning of the shared memory segment. The data areas of the two rings
+/// directly follow this header.
+struct SharedMemorySegmentHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	/// Capacity in bytes of each ring, must be a power of two
+	uint64_t ringCapacity;
+	/// Ring for messages sent from the client to the server
+	SharedMemoryRingHeader clientToServer;
+	/// Ring for messages sent from the server to the client
+	SharedMemoryRingHeader serverToClient;
+};
+
+/// This class represents a shared memory ring buffer transport in /dev/shm between the server
+/// and a client running on the same host. The segment is created by the server under a random
+/// name, which it tells only the client on the connection that asked for it, and attached to by
+/// that client. The name is unlinked as soon as the client has written to the ring. Records are
+/// framed as [uint32_t size][SERP message bytes], with size > 0.
+/// The head and tail written by the peer are only ever read, everything that bounds accesses to
+/// the mapping (ring capacity, our own head/tail) is kept in this object.
+class SharedMemoryChannel
+{
+public:
+	static constexpr uint32_t magic = 0x53455250; // "SERP"
+	static constexpr uint32_t version = 2;
+private:
+	/// Pointer to the mapped segment and size of the mapping
+	SharedMemorySegmentHeader* segment = nullptr;
+	std::size_t mappingSize = 0;
+	/// The ring we write to and the ring we read from (depends on which side we are on)
+	SharedMemoryRingHeader* outgoing = nullptr;
+	SharedMemoryRingHeader* incoming = nullptr;
+	std::byte* outgoingData = nullptr;
+	std::byte* incomingData = nullptr;
+	/// Capacity in bytes of each ring. Copied from the segment once, the peer can change the segment at any time.
+	uint64_t ringCapacity = 0;
+	/// Our position in the outgoing ring (head) and in the incoming ring (tail). We are the only writer
+	/// of these, so we never read them back from the segment.
+	uint64_t outgoingHead = 0;
+	uint64_t incomingTail = 0;
+	/// Name of the segment (as passed to shm_open)
+	std::string name;
+	/// true if this object created the segment and the name is not yet unlinked
+	bool owner = false;
+	/// Helper functions for copying from/to the ring data areas, handling wrap around
+	void copyToRing(std::byte* data, uint64_t position, const std::byte* source, std::size_t size) const;
+	void copyFromRing(const std::byte* data, uint64_t position, std::byte* destination, std::size_t size) const;
+	/// Pushes a single record to the outgoing ring. Waits at most timeoutMs for free space.
+	bool pushRecord(const std::byte* data, uint32_t size, int timeoutMs);
+	/// Increments the write sequence of the outgoing ring and wakes up the consumer if it is sleeping
+	void notifyConsumer();
+	/// Private constructor, use create() or attach()
+	SharedMemoryChannel() = default;
+public:
+	/// Creates a new segment with a random name and the given ring capacity (server side). The segment
+	/// is only accessible by the user with the given uid (and the server).
+	static std::unique_ptr<SharedMemoryChannel> create(uint64_t ringCapacity, uid_t peerUid);
+	/// Attaches to an existing segment created by the server (client side)
+	static std::unique_ptr<SharedMemoryChannel> attach(const std::string& name);
+	/// Returns true if a message of the given serialized size fits into the ring at all
+	bool fits(std::size_t size) const;
+	/// Serializes and writes the given message to the outgoing ring. Returns false if the message
+	/// does not fit or the peer did not free enough space in time.
+	bool sendMessage(SnackerEngine::SERPMessage& message, int timeoutMs);
+	/// Writes an already serialized message to the outgoing ring, like sendMessage()
+	bool sendSerializedMessage(const SnackerEngine::Buffer& serialized, int timeoutMs);
+	/// Rings the doorbell, telling the peer to check its socket. Never fails, even if the ring is full.
+	void ringDoorbell();
+	/// Waits at most timeoutMs for incoming records and parses all available messages. Sets
+	/// doorbell to true if the doorbell was rung. Returns std::nullopt if the ring contained a
+	/// malformed message. On the creating side, the name of the segment is unlinked once the
+	/// first record arrives.
+	std::optional<std::vector<std::unique_ptr<SnackerEngine::SERPMessage>>> receiveMessages(int timeoutMs, bool& doorbell);
+	/// Returns the name of the segment
+	const std::string& getName() const { return name; }
+	/// Destructor
+	~SharedMemoryChannel();
+	/// Deleted Copy and move constructors and assignment operators
+	SharedMemoryChannel(SharedMemoryChannel& other) = delete;
+	SharedMemoryChannel(SharedMemoryChannel&& other) = delete;
+	SharedMemoryChannel& operator=(SharedMemoryChannel& other) = delete;
+	SharedMemoryChannel& operator=(SharedMemoryChannel&& other) = delete;
+};
+
+#endif // _LINUX
@@ -0,0 +1,50 @@
+#include "SocketTuning.h"
+
+#ifdef _LINUX
+	#include <netinet/tcp.h>
+	#include <sys/socket.h>
+#endif // _LINUX
+
+std::optional<SocketProfile> getSocketProfile(const std::string& name)
+{
+	if (name == "interactive") return SocketProfile{};
+	if (name == "bulk") {
+		SocketProfile profile{};
+		profile.sendBufferSize = 4 * 1024 * 1024;
+		profile.receiveBufferSize = 4 * 1024 * 1024;
+		return profile;
+	}
+	if (name == "system") return SocketProfile{ false, false, 0, 0, false, 0, 0, 0 };
+	return {};
+}
+
+/// Helper function that sets an integer socket option
+static bool setOption(const SnackerEngine::SocketTCP& socket, int level, int option, int value)
+{
+	return setsockopt(socket.sock, level, option, reinterpret_cast<const char*>(&value), sizeof(value)) == 0;
+}
+
+bool applySocketProfile(const SnackerEngine::SocketTCP& socket, const SocketProfile& profile, bool local)
+{
+	bool success = true;
+	if (profile.sendBufferSize > 0) success &= setOption(socket, SOL_SOCKET, SO_SNDBUF, profile.sendBufferSize);
+	if (profile.receiveBufferSize > 0) success &= setOption(socket, SOL_SOCKET, SO_RCVBUF, profile.receiveBufferSize);
+	if (local) return success;
+	if (profile.noDelay) success &= setOption(socket, IPPROTO_TCP, TCP_NODELAY, 1);
+	if (profile.keepAlive) {
+		success &= setOption(socket, SOL_SOCKET, SO_KEEPALIVE, 1);
+#ifdef _LINUX
+		success &= setOption(socket, IPPROTO_TCP, TCP_KEEPIDLE, profile.keepAliveIdle);
+		success &= setOption(socket, IPPROTO_TCP, TCP_KEEPINTVL, profile.keepAliveInterval);
+		success &= setOption(socket, IPPROTO_TCP, TCP_KEEPCNT, profile.keepAliveCount);
+#endif // _LINUX
+	}
+	return success;
+}
+
+#ifdef _LINUX
+void setSocketCork(const SnackerEngine::SocketTCP& socket, bool cork)
+{
+	setOption(socket, IPPROTO_TCP, TCP_CORK, cork ? 1 : 0);
+}
+#endif // _LINUX
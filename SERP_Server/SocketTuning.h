@@ -0,0 +1,34 @@
+#pragma once
+#include "Network/Network.h"
+#include <optional>
+#include <string>
+
+/// Socket options that are applied to every accepted client socket
+struct SocketProfile
+{
+	/// Disables Nagle's algorithm, st. small messages are sent immediately
+	bool noDelay = true;
+	/// Corks the socket while the sender thread drains more than one queued message (linux only), st.
+	/// a batch of small messages leaves in as few segments as possible
+	bool corkBatches = true;
+	/// Size of the kernel send and receive buffers in bytes (0 keeps the system default)
+	int sendBufferSize = 0;
+	int receiveBufferSize = 0;
+	/// TCP keepalive. Idle time, interval between probes (both in seconds) and number of probes.
+	bool keepAlive = true;
+	int keepAliveIdle = 60;
+	int keepAliveInterval = 10;
+	int keepAliveCount = 5;
+};
+
+/// Returns the profile with the given name or std::nullopt if there is none. Profiles are
+/// "interactive" (small messages, low latency), "bulk" (large transfers, large buffers) and "system"
+/// (don't change any option).
+std::optional<SocketProfile> getSocketProfile(const std::string& name);
+/// Applies the given profile to the given socket. TCP options are skipped for local (AF_UNIX) sockets.
+/// Returns false if any option could not be set.
+bool applySocketProfile(const SnackerEngine::SocketTCP& socket, const SocketProfile& profile, bool local);
+#ifdef _LINUX
+/// Sets or clears TCP_CORK. Clearing it sends out all partial segments immediately.
+void setSocketCork(const SnackerEngine::SocketTCP& socket, bool cork);
+#endif // _LINUX
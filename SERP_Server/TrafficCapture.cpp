@@ -0,0 +1,117 @@
+#include "TrafficCapture.h"
+#include <cstring>
+
+void TrafficCapture::runWriterThread()
+{
+	std::vector<PendingMessage> batch;
+	std::vector<std::byte> buffer;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			conditionVariable.wait_for(lock, std::chrono::milliseconds(100), [this]() { return !running || !pendingBatch.empty(); });
+			// Take the whole batch, the receiving threads continue with an empty one
+			std::swap(batch, pendingBatch);
+			pendingBytes = 0;
+			if (!running && batch.empty()) break;
+		}
+		// Serialize the batch into one buffer, st. it is written with a single call
+		for (PendingMessage& pendingMessage : batch) {
+			SnackerEngine::Buffer serialized = pendingMessage.message->serialize();
+			pendingMessage.header.size = static_cast<uint32_t>(serialized.size());
+			std::size_t offset = buffer.size();
+			buffer.resize(offset + sizeof(pendingMessage.header) + serialized.size());
+			std::memcpy(buffer.data() + offset, &pendingMessage.header, sizeof(pendingMessage.header));
+			std::memcpy(buffer.data() + offset + sizeof(pendingMessage.header), serialized.data(), serialized.size());
+		}
+		batch.clear();
+		if (!buffer.empty()) {
+			file.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+			buffer.clear();
+		}
+	}
+	file.flush();
+}
+
+TrafficCapture::TrafficCapture(const std::string& path, std::size_t maxPendingBytes)
+	: file{ path, std::ios::binary | std::ios::trunc }, startTime{ std::chrono::steady_clock::now() }, pendingBatch{},
+	maxPendingBytes{ maxPendingBytes }, mutex{}, conditionVariable{}, writerThread{}
+{
+	if (!file.is_open()) throw std::runtime_error("Could not open capture file \"" + path + "\"!");
+	TrafficCaptureFileHeader header{};
+	std::memcpy(header.magic, magic, sizeof(magic));
+	header.version = version;
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	writerThread = std::thread(&TrafficCapture::runWriterThread, this);
+}
+
+void TrafficCapture::capture(SnackerEngine::SERPID source, SnackerEngine::SERPMessage& message)
+{
+	TrafficCaptureRecordHeader header{};
+	header.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+	header.source = static_cast<uint16_t>(static_cast<unsigned>(source));
+	// The body dominates the size of the serialized message
+	std::size_t size = sizeof(header) + message.content.size();
+	{
+		std::lock_guard lockGuard(mutex);
+		if (pendingBytes + size > maxPendingBytes) {
+			droppedMessages++;
+			return;
+		}
+	}
+	// Copy outside of the lock, serializing is left to the writer thread
+	std::unique_ptr<SnackerEngine::SERPMessage> copy;
+	if (message.isRequest()) copy = std::make_unique<SnackerEngine::SERPRequest>(static_cast<const SnackerEngine::SERPRequest&>(message));
+	else copy = std::make_unique<SnackerEngine::SERPResponse>(static_cast<const SnackerEngine::SERPResponse&>(message));
+	bool wasEmpty = false;
+	{
+		std::lock_guard lockGuard(mutex);
+		wasEmpty = pendingBatch.empty();
+		pendingBatch.push_back(PendingMessage{ header, std::move(copy) });
+		pendingBytes += size;
+	}
+	// The writer thread also wakes up regularly, we only have to notify it when a new batch starts
+	if (wasEmpty) conditionVariable.notify_one();
+}
+
+uint64_t TrafficCapture::getDroppedMessages()
+{
+	std::lock_guard lockGuard(mutex);
+	return droppedMessages;
+}
+
+std::optional<std::vector<CapturedMessage>> TrafficCapture::readCaptureFile(const std::string& path)
+{
+	std::ifstream input(path, std::ios::binary);
+	if (!input.is_open()) return {};
+	// A record can't be larger than the rest of the file. Checking that first keeps a corrupted size from
+	// making us allocate up to 4 GiB.
+	input.seekg(0, std::ios::end);
+	std::streamoff fileSize = input.tellg();
+	input.seekg(0, std::ios::beg);
+	if (fileSize < 0) return {};
+	TrafficCaptureFileHeader fileHeader{};
+	if (!input.read(reinterpret_cast<char*>(&fileHeader), sizeof(fileHeader))) return {};
+	if (std::memcmp(fileHeader.magic, magic, sizeof(magic)) != 0 || fileHeader.version != version) return {};
+	std::vector<CapturedMessage> messages;
+	TrafficCaptureRecordHeader header{};
+	SnackerEngine::Buffer buffer;
+	while (input.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+		if (static_cast<std::streamoff>(header.size) > fileSize - static_cast<std::streamoff>(input.tellg())) return {};
+		buffer.resize(header.size);
+		if (!input.read(reinterpret_cast<char*>(buffer.data()), header.size)) return {};
+		std::unique_ptr<SnackerEngine::SERPMessage> message = SnackerEngine::SERPMessage::parse(buffer.getBufferView());
+		if (!message) return {};
+		messages.push_back(CapturedMessage{ std::chrono::nanoseconds(header.timestamp), SnackerEngine::SERPID(header.source), std::move(message) });
+	}
+	return messages;
+}
+
+TrafficCapture::~TrafficCapture()
+{
+	{
+		std::lock_guard lockGuard(mutex);
+		running = false;
+	}
+	conditionVariable.notify_one();
+	writerThread.join();
+}
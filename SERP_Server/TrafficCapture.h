@@ -0,0 +1,87 @@
+#pragma once
+#include "Network/SERP/SERPEndpoint.h"
+#include <fstream>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+/// Header at the beginning of a capture file
+struct TrafficCaptureFileHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved;
+};
+
+/// Header in front of each captured message
+struct TrafficCaptureRecordHeader
+{
+	/// Time in ns since the capture was started
+	int64_t timestamp;
+	/// SERPID of the client that sent the message
+	uint16_t source;
+	uint16_t reserved;
+	/// Size of the serialized message following this header
+	uint32_t size;
+};
+
+/// A single message read from a capture file
+struct CapturedMessage
+{
+	std::chrono::nanoseconds timestamp;
+	SnackerEngine::SERPID source;
+	std::unique_ptr<SnackerEngine::SERPMessage> message;
+};
+
+/// This class writes all messages received by the server into a compact binary capture file, st. the
+/// traffic can later be replayed with replaySERPCapture. The receiving threads only copy the messages
+/// into an in-memory batch, a background writer thread serializes them and writes them to disk.
+class TrafficCapture
+{
+public:
+	static constexpr char magic[8] = { 'S', 'E', 'R', 'P', 'C', 'A', 'P', '1' };
+	static constexpr uint32_t version = 1;
+private:
+	/// The capture file
+	std::ofstream file;
+	/// Time at which the capture was started
+	std::chrono::steady_clock::time_point startTime;
+	/// A message waiting to be written
+	struct PendingMessage
+	{
+		TrafficCaptureRecordHeader header;
+		std::unique_ptr<SnackerEngine::SERPMessage> message;
+	};
+	/// Batch that is currently filled by the receiving threads, and the approximate number of bytes it holds
+	std::vector<PendingMessage> pendingBatch;
+	std::size_t pendingBytes = 0;
+	/// Maximal size of pendingBatch in bytes. If the writer can't keep up, messages are dropped.
+	std::size_t maxPendingBytes;
+	/// Number of dropped messages
+	uint64_t droppedMessages = 0;
+	/// Mutex and condition variable for handing batches to the writer thread
+	std::mutex mutex;
+	std::condition_variable conditionVariable;
+	/// true as long as the writer thread should keep running
+	bool running = true;
+	/// Writer thread
+	std::thread writerThread;
+	/// Function that is run by the writer thread
+	void runWriterThread();
+public:
+	/// Constructor. Throws if the file could not be opened.
+	TrafficCapture(const std::string& path, std::size_t maxPendingBytes = 64 * 1024 * 1024);
+	/// Captures the given message. Thread safe.
+	void capture(SnackerEngine::SERPID source, SnackerEngine::SERPMessage& message);
+	/// Returns the number of messages that were dropped because the writer could not keep up
+	uint64_t getDroppedMessages();
+	/// Reads all messages from the given capture file. Returns std::nullopt if the file is invalid or truncated.
+	static std::optional<std::vector<CapturedMessage>> readCaptureFile(const std::string& path);
+	/// Destructor. Writes all pending messages before returning.
+	~TrafficCapture();
+	/// Deleted Copy and move constructors and assignment operators
+	TrafficCapture(TrafficCapture& other) = delete;
+	TrafficCapture(TrafficCapture&& other) = delete;
+	TrafficCapture& operator=(TrafficCapture& other) = delete;
+	TrafficCapture& operator=(TrafficCapture&& other) = delete;
+};
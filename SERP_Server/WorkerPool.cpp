@@ -0,0 +1,89 @@
+#include "WorkerPool.h"
+
+bool WorkerPool::takeTask(std::size_t workerIndex, std::function<void()>& task)
+{
+	{
+		// Own queue first, oldest task first
+		Worker& worker = *workers[workerIndex];
+		std::lock_guard lockGuard(worker.mutex);
+		if (!worker.tasks.empty()) {
+			task = std::move(worker.tasks.front());
+			worker.tasks.pop_front();
+			return true;
+		}
+	}
+	// Steal the newest task of another worker, the owner works on the other end of the queue
+	for (std::size_t i = 1; i < workers.size(); ++i) {
+		Worker& victim = *workers[(workerIndex + i) % workers.size()];
+		std::lock_guard lockGuard(victim.mutex);
+		if (!victim.tasks.empty()) {
+			task = std::move(victim.tasks.back());
+			victim.tasks.pop_back();
+			workers[workerIndex]->stolenTasks++;
+			return true;
+		}
+	}
+	return false;
+}
+
+void WorkerPool::runWorkerThread(std::size_t workerIndex, std::function<void(std::size_t)> threadInit)
+{
+	if (threadInit) threadInit(workerIndex);
+	std::function<void()> task;
+	while (true) {
+		if (takeTask(workerIndex, task)) {
+			queuedTasks--;
+			task();
+			task = nullptr;
+			workers[workerIndex]->executedTasks++;
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		conditionVariable.wait(lock, [this]() { return queuedTasks > 0 || !running; });
+		if (!running && queuedTasks == 0) return;
+	}
+}
+
+WorkerPool::WorkerPool(std::size_t numberOfThreads, std::function<void(std::size_t)> threadInit)
+	: workers{}, threads{}, sleepMutex{}, conditionVariable{}
+{
+	for (std::size_t i = 0; i < numberOfThreads; ++i) workers.push_back(std::make_unique<Worker>());
+	for (std::size_t i = 0; i < numberOfThreads; ++i) threads.push_back(std::thread(&WorkerPool::runWorkerThread, this, i, threadInit));
+}
+
+void WorkerPool::submit(std::function<void()> task)
+{
+	{
+		// Count the task before it becomes visible, st. the counter never drops below zero. Taking the
+		// lock makes sure a worker that is about to sleep sees the new task.
+		std::lock_guard lockGuard(sleepMutex);
+		queuedTasks++;
+	}
+	Worker& worker = *workers[nextWorker++ % workers.size()];
+	{
+		std::lock_guard lockGuard(worker.mutex);
+		worker.tasks.push_back(std::move(task));
+	}
+	conditionVariable.notify_one();
+}
+
+std::string WorkerPool::getStatistics()
+{
+	std::string result = "{\"threads\":" + std::to_string(workers.size()) + ",\"queued\":" + std::to_string(queuedTasks.load()) + ",\"workers\":[";
+	for (std::size_t i = 0; i < workers.size(); ++i) {
+		if (i > 0) result += ",";
+		result += "{\"executed\":" + std::to_string(workers[i]->executedTasks.load()) + ",\"stolen\":" + std::to_string(workers[i]->stolenTasks.load()) + "}";
+	}
+	result += "]}";
+	return result;
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard lockGuard(sleepMutex);
+		running = false;
+	}
+	conditionVariable.notify_all();
+	for (std::thread& thread : threads) thread.join();
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <functional>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <string>
+
+/// Pool of worker threads with one task queue per worker. Tasks are distributed round robin, and idle
+/// workers steal tasks from the queues of busy workers, st. one slow task does not hold up the tasks
+/// queued behind it.
+class WorkerPool
+{
+	/// Task queue of a single worker
+	struct Worker
+	{
+		std::deque<std::function<void()>> tasks;
+		std::mutex mutex;
+		/// Number of tasks this worker executed and how many of them it stole from other workers
+		std::atomic<uint64_t> executedTasks = 0;
+		std::atomic<uint64_t> stolenTasks = 0;
+	};
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::vector<std::thread> threads;
+	/// Worker that gets the next submitted task
+	std::atomic<std::size_t> nextWorker = 0;
+	/// Number of tasks in all queues. Idle workers sleep on the condition variable while it is 0.
+	std::atomic<std::size_t> queuedTasks = 0;
+	std::mutex sleepMutex;
+	std::condition_variable conditionVariable;
+	/// true as long as the workers should keep running
+	std::atomic<bool> running = true;
+	/// Takes a task from the queue of the given worker, or steals one from another worker
+	bool takeTask(std::size_t workerIndex, std::function<void()>& task);
+	/// Function run by each worker thread
+	void runWorkerThread(std::size_t workerIndex, std::function<void(std::size_t)> threadInit);
+public:
+	/// Constructor. Starts the given number of worker threads, each of which first calls threadInit
+	/// with its index (eg. to set its CPU affinity).
+	WorkerPool(std::size_t numberOfThreads, std::function<void(std::size_t)> threadInit = {});
+	/// Queues a task. Thread safe.
+	void submit(std::function<void()> task);
+	/// Returns a JSON object with the number of threads, queued, executed and stolen tasks
+	std::string getStatistics();
+	/// Destructor. Finishes all queued tasks before returning.
+	~WorkerPool();
+	/// Deleted Copy and move constructors and assignment operators
+	WorkerPool(WorkerPool& other) = delete;
+	WorkerPool(WorkerPool&& other) = delete;
+	WorkerPool& operator=(WorkerPool& other) = delete;
+	WorkerPool& operator=(WorkerPool&& other) = delete;
+};
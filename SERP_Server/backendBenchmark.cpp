@@ -0,0 +1,202 @@
+#include "Network/Network.h"
+#include "Network/SERP/SERPEndpoint.h"
+#include "Utility/Formatting.h"
+
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <csignal>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/wait.h>
+
+/// A connection of the benchmark with the send times of its outstanding pings
+struct BenchmarkConnection
+{
+	std::unique_ptr<SnackerEngine::SERPEndpoint> endpoint;
+	std::deque<std::chrono::steady_clock::time_point> outstanding;
+};
+
+/// Result of a benchmark run
+struct BackendResult
+{
+	double responsesPerSecond = 0.0;
+	double meanRoundTrip = 0.0;
+	uint64_t threads = 0;
+};
+
+/// Connects to the server on the loopback interface. Returns nullptr on failure.
+std::unique_ptr<SnackerEngine::SERPEndpoint> connectToServer(uint16_t port)
+{
+	SnackerEngine::SocketTCP socketTCP;
+	socketTCP.sock = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (socketTCP.sock == -1) return nullptr;
+	sockaddr_in serverAddress{};
+	serverAddress.sin_family = AF_INET;
+	serverAddress.sin_port = htons(port);
+	serverAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (connect(socketTCP.sock, reinterpret_cast<sockaddr*>(&serverAddress), sizeof(serverAddress)) == -1) {
+		close(socketTCP.sock);
+		return nullptr;
+	}
+	return std::make_unique<SnackerEngine::SERPEndpoint>(std::move(socketTCP));
+}
+
+/// Sends a request to the server and waits for the response. Other messages are discarded.
+std::optional<std::string> requestFromServer(SnackerEngine::SERPEndpoint& endpoint, const std::string& target)
+{
+	SnackerEngine::SERPRequest request(SnackerEngine::RequestStatusCode::GET, target);
+	if (!endpoint.finalizeAndSendMessage(request, false)) return {};
+	while (endpoint.hasUnsentMessages()) endpoint.updateSend();
+	pollfd fileDescriptor{ endpoint.getTCPEndpoint().getSocket().sock, POLLIN, 0 };
+	while (poll(&fileDescriptor, 1, 5000) > 0) {
+		auto messages = endpoint.receiveMessages();
+		if (!messages.has_value()) return {};
+		for (auto& message : messages.value()) {
+			if (message->isRequest()) continue;
+			return std::string(reinterpret_cast<const char*>(message->content.data()), message->content.size());
+		}
+	}
+	return {};
+}
+
+/// Returns the value of the given key in a flat JSON object (0 if it is missing)
+uint64_t getJsonValue(const std::string& json, const std::string& key)
+{
+	std::size_t position = json.find("\"" + key + "\":");
+	if (position == std::string::npos) return 0;
+	return std::strtoull(json.c_str() + position + key.size() + 3, nullptr, 10);
+}
+
+/// Starts the server executable with the given number of I/O threads. Returns the pid or -1.
+pid_t startServer(const std::string& executable, unsigned ioThreads)
+{
+	pid_t pid = fork();
+	if (pid != 0) return pid;
+	// The output of the server would distort the measurement
+	freopen("/dev/null", "w", stdout);
+	std::string threads = std::to_string(ioThreads);
+	execl(executable.c_str(), executable.c_str(), "--ioThreads", threads.c_str(), "--localSocket", "", static_cast<char*>(nullptr));
+	_exit(127);
+}
+
+/// Stops the given server process
+void stopServer(pid_t pid)
+{
+	kill(pid, SIGTERM);
+	waitpid(pid, nullptr, 0);
+}
+
+/// Sends pings over the given number of connections for the given time, keeping window pings outstanding
+/// on each connection. Returns std::nullopt if the server could not be reached or stopped answering.
+std::optional<BackendResult> measureBackend(uint16_t port, std::size_t numberOfConnections, unsigned window, int seconds)
+{
+	// Wait until the server accepts connections
+	auto monitor = connectToServer(port);
+	for (int i = 0; !monitor && i < 50; ++i) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		monitor = connectToServer(port);
+	}
+	if (!monitor) return {};
+	std::vector<BenchmarkConnection> connections;
+	for (std::size_t i = 0; i < numberOfConnections; ++i) {
+		auto endpoint = connectToServer(port);
+		if (!endpoint) return {};
+		connections.push_back(BenchmarkConnection{ std::move(endpoint), {} });
+	}
+	std::vector<pollfd> fileDescriptors;
+	for (auto& connection : connections) fileDescriptors.push_back(pollfd{ connection.endpoint->getTCPEndpoint().getSocket().sock, POLLIN, 0 });
+	SnackerEngine::SERPRequest ping(SnackerEngine::RequestStatusCode::GET, "ping");
+	uint64_t numberOfResponses = 0;
+	double totalRoundTrip = 0.0;
+	auto startTime = std::chrono::steady_clock::now();
+	auto endTime = startTime + std::chrono::seconds(seconds);
+	while (std::chrono::steady_clock::now() < endTime) {
+		// Refill the windows
+		for (auto& connection : connections) {
+			while (connection.outstanding.size() < window) {
+				if (!connection.endpoint->finalizeAndSendMessage(ping, false)) return {};
+				connection.outstanding.push_back(std::chrono::steady_clock::now());
+			}
+			while (connection.endpoint->hasUnsentMessages()) connection.endpoint->updateSend();
+		}
+		int result = poll(fileDescriptors.data(), fileDescriptors.size(), 5000);
+		if (result <= 0) return {};
+		for (std::size_t i = 0; i < connections.size(); ++i) {
+			if (!(fileDescriptors[i].revents & POLLIN)) continue;
+			auto messages = connections[i].endpoint->receiveMessages();
+			if (!messages.has_value()) return {};
+			auto now = std::chrono::steady_clock::now();
+			for (auto& message : messages.value()) {
+				if (message->isRequest() || connections[i].outstanding.empty()) continue;
+				totalRoundTrip += std::chrono::duration<double, std::micro>(now - connections[i].outstanding.front()).count();
+				connections[i].outstanding.pop_front();
+				numberOfResponses++;
+			}
+		}
+	}
+	double duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	auto statistics = requestFromServer(*monitor, "stats/resources");
+	if (!statistics.has_value() || numberOfResponses == 0) return {};
+	return BackendResult{ static_cast<double>(numberOfResponses) / duration, totalRoundTrip / static_cast<double>(numberOfResponses), getJsonValue(statistics.value(), "threads") };
+}
+
+/// Compares the I/O backends of the server: a sender and a receiver thread per client (poll) against
+/// I/O threads that share one io_uring instance each. The server executable is started once per backend.
+int main(int argc, char** argv)
+{
+	if (argc < 2) {
+		std::cout << "usage: benchmarkSERPBackends <path to SERPServer> [--clients <connections>] [--window <outstanding pings>] [--seconds <duration>] [--ioThreads <threads>]" << std::endl;
+		return -1;
+	}
+	std::string executable = argv[1];
+	unsigned numberOfConnections = 64;
+	unsigned window = 8;
+	unsigned seconds = 10;
+	unsigned ioThreads = 2;
+	for (int i = 2; i < argc; ++i) {
+		std::string argument = argv[i];
+		std::optional<unsigned> value = i + 1 < argc ? SnackerEngine::from_string<unsigned>(argv[i + 1]) : std::nullopt;
+		if (!value.has_value() || value.value() == 0) {
+			std::cout << "[ERROR]: Invalid command line argument \"" << argument << "\"." << std::endl;
+			return -1;
+		}
+		if (argument == "--clients") numberOfConnections = value.value();
+		else if (argument == "--window") window = value.value();
+		else if (argument == "--seconds") seconds = value.value();
+		else if (argument == "--ioThreads") ioThreads = value.value();
+		else {
+			std::cout << "[ERROR]: Invalid command line argument \"" << argument << "\"." << std::endl;
+			return -1;
+		}
+		++i;
+	}
+	SnackerEngine::initializeNetwork();
+	uint16_t port = SnackerEngine::getSERPServerPort();
+	// Make sure we don't measure a server that is already running
+	if (auto endpoint = connectToServer(port)) {
+		std::cout << "[ERROR]: Another server is already listening on port " << port << "." << std::endl;
+		return -1;
+	}
+	std::cout << "backend\tclients\tresponses/s\tround trip us\tserver threads" << std::endl;
+	for (unsigned threads : { 0u, ioThreads }) {
+		pid_t pid = startServer(executable, threads);
+		if (pid == -1) {
+			std::cout << "[ERROR]: Could not start \"" << executable << "\"." << std::endl;
+			return -1;
+		}
+		auto result = measureBackend(port, numberOfConnections, window, static_cast<int>(seconds));
+		stopServer(pid);
+		std::string name = threads == 0 ? "poll" : "io_uring(" + std::to_string(threads) + ")";
+		if (!result.has_value()) {
+			std::cout << name << "\t" << numberOfConnections << "\tfailed" << std::endl;
+			continue;
+		}
+		std::cout << name << "\t" << numberOfConnections << "\t" << result->responsesPerSecond << "\t" << result->meanRoundTrip << "\t" << result->threads << std::endl;
+		// Give the kernel time to release the port
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+	}
+	return 0;
+}
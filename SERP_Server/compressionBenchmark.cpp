@@ -0,0 +1,82 @@
+#include "TrafficCapture.h"
+#include "Compression.h"
+
+#include <iostream>
+#include <chrono>
+#include <charconv>
+#include <string_view>
+
+/// Prints the command line arguments of the benchmark
+static void printUsage()
+{
+	std::cout << "usage: benchmarkSERPCompression <capture file> [minimal body size]" << std::endl;
+}
+
+/// Compresses all message bodies of a capture file with different compression levels and reports the CPU
+/// time spent against the bytes saved, st. the codec and level can be chosen on representative payloads.
+int main(int argc, char** argv)
+{
+	if (argc < 2 || argc > 3) {
+		printUsage();
+		return -1;
+	}
+	std::size_t minimalBodySize = 0;
+	if (argc > 2) {
+		// The whole argument has to be a number
+		std::string_view argument = argv[2];
+		auto result = std::from_chars(argument.data(), argument.data() + argument.size(), minimalBodySize);
+		if (result.ec != std::errc() || result.ptr != argument.data() + argument.size()) {
+			std::cout << "[ERROR]: Invalid minimal body size \"" << argument << "\"." << std::endl;
+			printUsage();
+			return -1;
+		}
+	}
+	auto capture = TrafficCapture::readCaptureFile(argv[1]);
+	if (!capture.has_value()) {
+		std::cout << "[ERROR]: Could not read capture file \"" << argv[1] << "\"." << std::endl;
+		return -1;
+	}
+	std::vector<const SnackerEngine::Buffer*> bodies;
+	std::size_t totalBytes = 0;
+	for (const auto& capturedMessage : capture.value()) {
+		if (isFramedBody(capturedMessage.message->content)) continue;
+		if (capturedMessage.message->content.size() < minimalBodySize || capturedMessage.message->content.size() == 0) continue;
+		bodies.push_back(&capturedMessage.message->content);
+		totalBytes += capturedMessage.message->content.size();
+	}
+	if (bodies.empty()) {
+		std::cout << "[ERROR]: Capture file contains no uncompressed bodies of at least " << minimalBodySize << " bytes." << std::endl;
+		return -1;
+	}
+	std::cout << "[INFO]: " << bodies.size() << " bodies with " << totalBytes << " bytes in total." << std::endl;
+	std::cout << "level\tcompressed bytes\tsaved\tcompress MB/s\tdecompress MB/s\tus per body" << std::endl;
+	SnackerEngine::Buffer compressed;
+	SnackerEngine::Buffer decompressed;
+	for (int level = 1; level <= 9; ++level) {
+		std::size_t compressedBytes = 0;
+		std::chrono::nanoseconds compressTime{ 0 };
+		std::chrono::nanoseconds decompressTime{ 0 };
+		for (const SnackerEngine::Buffer* body : bodies) {
+			auto start = std::chrono::steady_clock::now();
+			if (!compressBuffer(CompressionCodec::DEFLATE, *body, compressed, level)) {
+				std::cout << "[ERROR]: Compression failed. Was the server built with SERP_COMPRESSION?" << std::endl;
+				return -1;
+			}
+			auto middle = std::chrono::steady_clock::now();
+			if (!decompressBuffer(compressed, decompressed, body->size())) {
+				std::cout << "[ERROR]: Decompression failed." << std::endl;
+				return -1;
+			}
+			auto end = std::chrono::steady_clock::now();
+			compressTime += middle - start;
+			decompressTime += end - middle;
+			compressedBytes += compressed.size();
+		}
+		double megabytes = static_cast<double>(totalBytes) / (1024.0 * 1024.0);
+		std::cout << level << "\t" << compressedBytes << "\t" << 100.0 - 100.0 * static_cast<double>(compressedBytes) / static_cast<double>(totalBytes) << "%\t"
+			<< megabytes / std::chrono::duration<double>(compressTime).count() << "\t"
+			<< megabytes / std::chrono::duration<double>(decompressTime).count() << "\t"
+			<< std::chrono::duration<double, std::micro>(compressTime).count() / static_cast<double>(bodies.size()) << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,80 @@
+#include "Network/Network.h"
+#include "Network/SERP/SERPEndpoint.h"
+#include "Compression.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/// Reads everything that is available on the endpoint. Returns false if the endpoint rejected the input.
+static bool receiveAvailable(SnackerEngine::SERPEndpoint& endpoint, std::vector<std::unique_ptr<SnackerEngine::SERPMessage>>& messages)
+{
+	pollfd fileDescriptor{ endpoint.getTCPEndpoint().getSocket().sock, POLLIN, 0 };
+	while (poll(&fileDescriptor, 1, 0) > 0) {
+		auto received = endpoint.receiveMessages();
+		if (!received.has_value()) return false;
+		for (auto& message : received.value()) messages.push_back(std::move(message));
+		// The peer closed its end and everything was read
+		if (fileDescriptor.revents & POLLHUP) break;
+	}
+	return true;
+}
+
+/// Checks that serializing a message and parsing the result again gives the same message. Aborts otherwise,
+/// st. libFuzzer reports the input.
+static void checkRoundTrip(SnackerEngine::SERPMessage& message)
+{
+	SnackerEngine::Buffer serialized = message.serialize();
+	std::unique_ptr<SnackerEngine::SERPMessage> parsed = SnackerEngine::SERPMessage::parse(serialized.getBufferView());
+	if (!parsed || parsed->isRequest() != message.isRequest()) std::abort();
+	// Two messages are equal if they have the same wire format
+	SnackerEngine::Buffer reserialized = parsed->serialize();
+	if (reserialized.size() != serialized.size() || std::memcmp(reserialized.data(), serialized.data(), serialized.size()) != 0) std::abort();
+}
+
+/// libFuzzer entry point for the message parser. The input is written in two parts into a socket pair and
+/// read by a SERPEndpoint, st. the reassembly of messages that arrive in pieces is covered as well. Every
+/// parsed message has to survive a serialize/parse round trip, and framed bodies are decoded like the server
+/// does.
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, std::size_t size)
+{
+	if (size == 0) return 0;
+	// The first byte selects where the input is split
+	std::size_t split = std::min<std::size_t>(data[0], size - 1);
+	const std::byte* input = reinterpret_cast<const std::byte*>(data + 1);
+	std::size_t inputSize = size - 1;
+	int sockets[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, sockets) != 0) std::abort();
+	SnackerEngine::SocketTCP socketTCP;
+	socketTCP.sock = sockets[0];
+	SnackerEngine::SERPEndpoint endpoint{ std::move(socketTCP) };
+	std::vector<std::unique_ptr<SnackerEngine::SERPMessage>> messages;
+	bool valid = true;
+	for (auto [offset, length] : { std::make_pair(std::size_t(0), split), std::make_pair(split, inputSize - split) }) {
+		// Inputs larger than the socket buffer are written in pieces, the endpoint reads in between
+		while (valid && length > 0) {
+			ssize_t written = send(sockets[1], input + offset, length, MSG_NOSIGNAL);
+			if (written > 0) {
+				offset += static_cast<std::size_t>(written);
+				length -= static_cast<std::size_t>(written);
+			}
+			valid = receiveAvailable(endpoint, messages);
+		}
+	}
+	close(sockets[1]);
+	// The server disconnects the client on malformed input, the messages before it were valid anyway
+	if (valid) receiveAvailable(endpoint, messages);
+	for (auto& message : messages) {
+		checkRoundTrip(*message);
+		if (isFramedBody(message->content)) {
+			SnackerEngine::Buffer decompressed;
+			decompressBuffer(message->content, decompressed, 64 * 1024 * 1024);
+		}
+	}
+	return 0;
+}
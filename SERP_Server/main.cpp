@@ -2,11 +2,12 @@
 #include "Server.h"
 #include "Network/Network.h"
 
-int main()
+int main(int argc, char** argv)
 {
 	try {
 		SnackerEngine::initializeNetwork();
 		Server server;
+		if (!server.parseCommandLineArguments(argc, argv)) return -1;
 		server.run();
 	}
 	catch (std::exception& e) {
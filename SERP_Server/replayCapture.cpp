@@ -0,0 +1,156 @@
+#include "TrafficCapture.h"
+#include "Network/Network.h"
+#include "Utility/Formatting.h"
+
+#include <iostream>
+#include <unordered_map>
+#include <thread>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+
+/// A connection to the server that replays the messages of one recorded client
+struct ReplayConnection
+{
+	std::unique_ptr<SnackerEngine::SERPEndpoint> endpoint;
+	SnackerEngine::SERPID serpID;
+};
+
+/// Connects to the server at the given address and port. Returns nullptr on failure.
+std::unique_ptr<SnackerEngine::SERPEndpoint> connectToServer(const std::string& address, uint16_t port)
+{
+	SnackerEngine::SocketTCP socketTCP;
+	socketTCP.sock = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (socketTCP.sock == -1) return nullptr;
+	sockaddr_in serverAddress{};
+	serverAddress.sin_family = AF_INET;
+	serverAddress.sin_port = htons(port);
+	if (inet_pton(AF_INET, address.c_str(), &serverAddress.sin_addr) != 1 ||
+		connect(socketTCP.sock, reinterpret_cast<sockaddr*>(&serverAddress), sizeof(serverAddress)) == -1) {
+		close(socketTCP.sock);
+		return nullptr;
+	}
+	return std::make_unique<SnackerEngine::SERPEndpoint>(std::move(socketTCP));
+}
+
+/// Asks the server for the SERPID of the given connection
+std::optional<SnackerEngine::SERPID> requestSerpID(SnackerEngine::SERPEndpoint& endpoint)
+{
+	SnackerEngine::SERPRequest request(SnackerEngine::RequestStatusCode::GET, "serpID");
+	if (!endpoint.finalizeAndSendMessage(request, false)) return {};
+	while (endpoint.hasUnsentMessages()) endpoint.updateSend();
+	pollfd fileDescriptor{ endpoint.getTCPEndpoint().getSocket().sock, POLLIN, 0 };
+	while (poll(&fileDescriptor, 1, 5000) > 0) {
+		auto messages = endpoint.receiveMessages();
+		if (!messages.has_value()) return {};
+		for (auto& message : messages.value()) {
+			if (message->isRequest()) continue;
+			std::string content(reinterpret_cast<const char*>(message->content.data()), message->content.size());
+			return SnackerEngine::from_string<SnackerEngine::SERPID>(content);
+		}
+	}
+	return {};
+}
+
+/// Number of messages that are sent in fast mode before the connections are drained
+static constexpr std::size_t fastBatchSize = 64;
+
+/// Reads and discards everything the server sent to the connections, st. socket buffers don't fill up.
+/// Waits at most timeout for data with a single poll() over all connections.
+void drainConnections(std::vector<pollfd>& fileDescriptors, std::vector<SnackerEngine::SERPEndpoint*>& endpoints, std::chrono::milliseconds timeout)
+{
+	auto endTime = std::chrono::steady_clock::now() + timeout;
+	while (true) {
+		int remaining = static_cast<int>(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::milliseconds>(endTime - std::chrono::steady_clock::now()).count()));
+		if (poll(fileDescriptors.data(), fileDescriptors.size(), remaining) <= 0) return;
+		for (std::size_t i = 0; i < fileDescriptors.size(); ++i) {
+			if (fileDescriptors[i].revents & POLLIN) endpoints[i]->receiveMessages();
+			// A closed connection would be reported by every poll() from now on
+			if (fileDescriptors[i].revents & (POLLHUP | POLLERR | POLLNVAL)) fileDescriptors[i].fd = -1;
+		}
+		if (remaining == 0) return;
+	}
+}
+
+/// Maps a recorded SERPID to the SERPID of the connection replaying it (unknown SERPIDs are kept)
+SnackerEngine::SERPID mapSerpID(const std::unordered_map<unsigned, ReplayConnection>& connections, SnackerEngine::SERPID recorded)
+{
+	auto result = connections.find(static_cast<unsigned>(recorded));
+	if (result == connections.end()) return recorded;
+	return result->second.serpID;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2) {
+		std::cout << "usage: replaySERPCapture <capture file> [--fast] [--address <ipv4 address>]" << std::endl;
+		return -1;
+	}
+	bool fast = false;
+	std::string address = "127.0.0.1";
+	for (int i = 2; i < argc; ++i) {
+		std::string argument = argv[i];
+		if (argument == "--fast") fast = true;
+		else if (argument == "--address" && i + 1 < argc) address = argv[++i];
+		else {
+			std::cout << "[ERROR]: Invalid argument \"" << argument << "\"." << std::endl;
+			return -1;
+		}
+	}
+	auto capture = TrafficCapture::readCaptureFile(argv[1]);
+	if (!capture.has_value()) {
+		std::cout << "[ERROR]: Could not read capture file \"" << argv[1] << "\"." << std::endl;
+		return -1;
+	}
+	SnackerEngine::initializeNetwork();
+	// Open one connection per recorded client
+	std::unordered_map<unsigned, ReplayConnection> connections;
+	for (const auto& capturedMessage : capture.value()) {
+		if (connections.contains(static_cast<unsigned>(capturedMessage.source))) continue;
+		auto endpoint = connectToServer(address, SnackerEngine::getSERPServerPort());
+		if (!endpoint) {
+			std::cout << "[ERROR]: Could not connect to server at " << address << "." << std::endl;
+			return -1;
+		}
+		auto serpID = requestSerpID(*endpoint);
+		if (!serpID.has_value()) {
+			std::cout << "[ERROR]: Could not get serpID from server." << std::endl;
+			return -1;
+		}
+		connections.insert(std::make_pair<>(static_cast<unsigned>(capturedMessage.source), ReplayConnection{ std::move(endpoint), serpID.value() }));
+	}
+	// One poll() over all connections instead of one per connection
+	std::vector<pollfd> fileDescriptors;
+	std::vector<SnackerEngine::SERPEndpoint*> endpoints;
+	for (auto& connection : connections) {
+		fileDescriptors.push_back(pollfd{ connection.second.endpoint->getTCPEndpoint().getSocket().sock, POLLIN, 0 });
+		endpoints.push_back(connection.second.endpoint.get());
+	}
+	std::cout << "[INFO]: Replaying " << capture.value().size() << " messages from " << connections.size() << " clients" << (fast ? " as fast as possible." : " with recorded timing.") << std::endl;
+	// Replay the messages, rewriting the recorded SERPIDs to the SERPIDs of our connections
+	auto startTime = std::chrono::steady_clock::now();
+	std::size_t numberOfSentMessages = 0;
+	for (auto& capturedMessage : capture.value()) {
+		// With recorded timing we drain the connections while waiting for the next message
+		if (!fast) drainConnections(fileDescriptors, endpoints, std::chrono::ceil<std::chrono::milliseconds>(startTime + capturedMessage.timestamp - std::chrono::steady_clock::now()));
+		SnackerEngine::SERPMessage& message = *capturedMessage.message;
+		message.getHeader().source = mapSerpID(connections, capturedMessage.source);
+		message.getHeader().destination = mapSerpID(connections, message.getHeader().destination);
+		if (message.getHeader().getMultiSendFlag()) {
+			std::unordered_set<uint16_t> destinations = message.getDestinations();
+			message.clearDestinations();
+			for (auto destination : destinations) message.addDestination(static_cast<uint16_t>(static_cast<unsigned>(mapSerpID(connections, destination))));
+		}
+		SnackerEngine::SERPEndpoint& endpoint = *connections.at(static_cast<unsigned>(capturedMessage.source)).endpoint;
+		endpoint.finalizeAndSendMessage(message, false);
+		while (endpoint.hasUnsentMessages()) {
+			endpoint.updateSend();
+			// The server may wait for us to read before it reads again
+			if (endpoint.hasUnsentMessages()) drainConnections(fileDescriptors, endpoints, std::chrono::milliseconds(0));
+		}
+		if (fast && ++numberOfSentMessages % fastBatchSize == 0) drainConnections(fileDescriptors, endpoints, std::chrono::milliseconds(0));
+	}
+	auto duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	std::cout << "[INFO]: Replayed " << capture.value().size() << " messages in " << duration << " s (" << static_cast<double>(capture.value().size()) / duration << " messages/s)." << std::endl;
+	return 0;
+}
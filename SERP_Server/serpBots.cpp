@@ -0,0 +1,90 @@
+#include "AsyncSERPClient.h"
+#include "Network/Network.h"
+#include "Utility/Formatting.h"
+
+#include <iostream>
+#include <vector>
+
+/// Results of all sessions
+struct BotStatistics
+{
+	uint64_t responses = 0;
+	uint64_t timeouts = 0;
+	uint64_t sumLatencyMicroseconds = 0;
+};
+
+/// A logical session: pings the server every interval until the deadline has passed
+Task<void> runSession(SERPEventLoop& loop, AsyncSERPConnection& connection, std::chrono::steady_clock::time_point deadline, std::chrono::milliseconds interval, BotStatistics& statistics)
+{
+	while (connection.isConnected() && std::chrono::steady_clock::now() < deadline) {
+		auto sendTime = std::chrono::steady_clock::now();
+		auto response = co_await connection.request(SnackerEngine::SERPID::SERVER_ID, SnackerEngine::RequestStatusCode::GET, "ping");
+		if (!response) {
+			statistics.timeouts++;
+			continue;
+		}
+		statistics.responses++;
+		statistics.sumLatencyMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - sendTime).count();
+		co_await loop.sleep(interval);
+	}
+}
+
+/// Connects a bot and starts its sessions once it got its SERPID
+Task<void> startBot(SERPEventLoop& loop, AsyncSERPConnection& connection, unsigned numberOfSessions, std::chrono::steady_clock::time_point deadline, std::chrono::milliseconds interval, BotStatistics& statistics)
+{
+	if (!co_await connection.start()) {
+		std::cout << "[ERROR]: Could not get serpID from server." << std::endl;
+		co_return;
+	}
+	for (unsigned i = 0; i < numberOfSessions; ++i) loop.spawn(runSession(loop, connection, deadline, interval, statistics));
+}
+
+int main(int argc, char** argv)
+{
+	std::string address = "127.0.0.1";
+	unsigned numberOfConnections = 4;
+	unsigned numberOfSessions = 1000;
+	unsigned seconds = 10;
+	unsigned intervalMilliseconds = 100;
+	for (int i = 1; i < argc; ++i) {
+		std::string argument = argv[i];
+		if (argument == "--address" && i + 1 < argc) {
+			address = argv[++i];
+			continue;
+		}
+		std::optional<unsigned> value = i + 1 < argc ? SnackerEngine::from_string<unsigned>(argv[i + 1]) : std::nullopt;
+		// Only the interval may be 0
+		if (!value.has_value() || (value.value() == 0 && argument != "--interval")) {
+			std::cout << "[ERROR]: Invalid command line argument \"" << argument << "\"." << std::endl;
+			return -1;
+		}
+		if (argument == "--connections") numberOfConnections = value.value();
+		else if (argument == "--sessions") numberOfSessions = value.value();
+		else if (argument == "--seconds") seconds = value.value();
+		else if (argument == "--interval") intervalMilliseconds = value.value();
+		else {
+			std::cout << "usage: runSERPBots [--address <ipv4 address>] [--connections <count>] [--sessions <count per connection>] [--seconds <duration>] [--interval <ms>]" << std::endl;
+			return -1;
+		}
+		++i;
+	}
+	SnackerEngine::initializeNetwork();
+	SERPEventLoop loop;
+	BotStatistics statistics;
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+	std::vector<std::unique_ptr<AsyncSERPConnection>> connections;
+	for (unsigned i = 0; i < numberOfConnections; ++i) {
+		auto connection = AsyncSERPConnection::connect(loop, address, SnackerEngine::getSERPServerPort());
+		if (!connection) {
+			std::cout << "[ERROR]: Could not connect to server at " << address << "." << std::endl;
+			return -1;
+		}
+		loop.spawn(startBot(loop, *connection, numberOfSessions, deadline, std::chrono::milliseconds(intervalMilliseconds), statistics));
+		connections.push_back(std::move(connection));
+	}
+	std::cout << "[INFO]: Running " << numberOfConnections * numberOfSessions << " sessions on " << numberOfConnections << " connections for " << seconds << " s." << std::endl;
+	loop.run();
+	std::cout << "[INFO]: " << statistics.responses << " responses, " << statistics.timeouts << " timeouts, mean latency "
+		<< (statistics.responses > 0 ? statistics.sumLatencyMicroseconds / statistics.responses : 0) << " us." << std::endl;
+	return 0;
+}
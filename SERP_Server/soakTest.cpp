@@ -0,0 +1,321 @@
+#include "Network/Network.h"
+#include "Network/SERP/SERPEndpoint.h"
+#include "Utility/Formatting.h"
+
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <csignal>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/wait.h>
+
+/// A connection opened by the soak test
+struct SoakConnection
+{
+	std::unique_ptr<SnackerEngine::SERPEndpoint> endpoint;
+	SnackerEngine::SERPID serpID;
+};
+
+/// Resource usage of the server as reported by GET stats/resources
+struct ResourceSample
+{
+	double time = 0.0;
+	uint64_t residentBytes = 0;
+	uint64_t threads = 0;
+	uint64_t liveClients = 0;
+	uint64_t disconnectedClients = 0;
+};
+
+/// Number of connects in a row that may fail before the test gives up, and the time between them
+static constexpr unsigned maxConnectFailures = 50;
+static constexpr std::chrono::milliseconds connectRetryInterval{ 100 };
+
+/// Connects to the server on the loopback interface. Returns nullptr on failure.
+std::unique_ptr<SnackerEngine::SERPEndpoint> connectToServer(uint16_t port)
+{
+	SnackerEngine::SocketTCP socketTCP;
+	socketTCP.sock = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (socketTCP.sock == -1) return nullptr;
+	sockaddr_in serverAddress{};
+	serverAddress.sin_family = AF_INET;
+	serverAddress.sin_port = htons(port);
+	serverAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (connect(socketTCP.sock, reinterpret_cast<sockaddr*>(&serverAddress), sizeof(serverAddress)) == -1) {
+		close(socketTCP.sock);
+		return nullptr;
+	}
+	return std::make_unique<SnackerEngine::SERPEndpoint>(std::move(socketTCP));
+}
+
+/// Starts the server executable. Returns the pid or -1.
+pid_t startServer(const std::string& executable)
+{
+	pid_t pid = fork();
+	if (pid != 0) return pid;
+	// The server logs every message, which would bury our output
+	freopen("/dev/null", "w", stdout);
+	execl(executable.c_str(), executable.c_str(), "--localSocket", "", static_cast<char*>(nullptr));
+	_exit(127);
+}
+
+/// Returns true if the server process is still running
+bool isServerRunning(pid_t pid)
+{
+	return waitpid(pid, nullptr, WNOHANG) == 0;
+}
+
+/// Stops the given server process
+void stopServer(pid_t pid)
+{
+	kill(pid, SIGTERM);
+	waitpid(pid, nullptr, 0);
+}
+
+/// Sends a request to the server and waits for the response. Other messages are discarded.
+std::optional<std::string> requestFromServer(SnackerEngine::SERPEndpoint& endpoint, const std::string& target)
+{
+	SnackerEngine::SERPRequest request(SnackerEngine::RequestStatusCode::GET, target);
+	if (!endpoint.finalizeAndSendMessage(request, false)) return {};
+	while (endpoint.hasUnsentMessages()) endpoint.updateSend();
+	pollfd fileDescriptor{ endpoint.getTCPEndpoint().getSocket().sock, POLLIN, 0 };
+	while (poll(&fileDescriptor, 1, 5000) > 0) {
+		auto messages = endpoint.receiveMessages();
+		if (!messages.has_value()) return {};
+		for (auto& message : messages.value()) {
+			if (message->isRequest()) continue;
+			return std::string(reinterpret_cast<const char*>(message->content.data()), message->content.size());
+		}
+	}
+	return {};
+}
+
+/// Returns the value of the given key in a flat JSON object (0 if it is missing)
+uint64_t getJsonValue(const std::string& json, const std::string& key)
+{
+	std::size_t position = json.find("\"" + key + "\":");
+	if (position == std::string::npos) return 0;
+	return std::strtoull(json.c_str() + position + key.size() + 3, nullptr, 10);
+}
+
+/// Reads and discards everything the server sent to the given connections. Connections the server
+/// closed are removed.
+void drainConnections(std::vector<SoakConnection>& connections)
+{
+	std::erase_if(connections, [](SoakConnection& connection) {
+		pollfd fileDescriptor{ connection.endpoint->getTCPEndpoint().getSocket().sock, POLLIN, 0 };
+		if (poll(&fileDescriptor, 1, 0) <= 0) return false;
+		return !connection.endpoint->receiveMessages().has_value();
+	});
+}
+
+/// Returns the smallest resident set size of the given samples
+uint64_t getMinimumResidentBytes(std::vector<ResourceSample>::const_iterator begin, std::vector<ResourceSample>::const_iterator end)
+{
+	uint64_t result = UINT64_MAX;
+	for (auto it = begin; it != end; ++it) result = std::min(result, it->residentBytes);
+	return result;
+}
+
+/// Runs the soak test against the server with the given pid. Returns the exit code of the test.
+int soak(pid_t pid, uint16_t port, unsigned seconds, std::size_t maxClients, unsigned seed, uint64_t residentTolerance)
+{
+	// The monitor connection stays open during the whole test and samples the resource usage of the server.
+	// Wait until the server accepts connections.
+	auto monitor = connectToServer(port);
+	for (unsigned i = 0; !monitor && i < maxConnectFailures && isServerRunning(pid); ++i) {
+		std::this_thread::sleep_for(connectRetryInterval);
+		monitor = connectToServer(port);
+	}
+	if (!monitor) {
+		std::cout << "[ERROR]: Could not connect to the server." << std::endl;
+		return -1;
+	}
+	auto startTime = std::chrono::steady_clock::now();
+	auto sample = [&]() -> std::optional<ResourceSample> {
+		auto statistics = requestFromServer(*monitor, "stats/resources");
+		if (!statistics.has_value()) return {};
+		return ResourceSample{ std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count(), getJsonValue(statistics.value(), "residentBytes"),
+			getJsonValue(statistics.value(), "threads"), getJsonValue(statistics.value(), "liveClients"), getJsonValue(statistics.value(), "disconnectedClients") };
+	};
+	auto baseline = sample();
+	if (!baseline.has_value()) {
+		std::cout << "[ERROR]: The server did not answer GET stats/resources." << std::endl;
+		return -1;
+	}
+	std::cout << "[INFO]: Soaking server for " << seconds << " s with up to " << maxClients << " clients (seed " << seed << ")." << std::endl;
+	std::mt19937 random(seed);
+	std::vector<SoakConnection> connections;
+	// Recently used SERPIDs of closed connections, targets for messages to vanished clients
+	std::deque<SnackerEngine::SERPID> vanishedSerpIDs;
+	std::vector<ResourceSample> samples;
+	uint64_t numberOfOperations = 0;
+	unsigned connectFailures = 0;
+	auto endTime = startTime + std::chrono::seconds(seconds);
+	auto nextSampleTime = startTime;
+	auto randomSerpID = [&]() -> SnackerEngine::SERPID {
+		if (!vanishedSerpIDs.empty() && random() % 2 == 0) return vanishedSerpIDs[random() % vanishedSerpIDs.size()];
+		if (!connections.empty()) return connections[random() % connections.size()].serpID;
+		return SnackerEngine::getRandomSerpID();
+	};
+	auto closeConnection = [&](std::size_t index) {
+		vanishedSerpIDs.push_back(connections[index].serpID);
+		if (vanishedSerpIDs.size() > 256) vanishedSerpIDs.pop_front();
+		connections.erase(connections.begin() + static_cast<std::ptrdiff_t>(index));
+	};
+	while (std::chrono::steady_clock::now() < endTime) {
+		unsigned operation = random() % 100;
+		if (connections.empty() || (operation < 15 && connections.size() < maxClients)) {
+			// Connect. A refused connect means the server died or its backlog is full, don't hammer it.
+			auto endpoint = connectToServer(port);
+			if (!endpoint) {
+				if (!isServerRunning(pid)) {
+					std::cout << "[ERROR]: The server exited after " << numberOfOperations << " operations." << std::endl;
+					return 1;
+				}
+				if (++connectFailures >= maxConnectFailures) {
+					std::cout << "[ERROR]: The server refused " << connectFailures << " connections in a row after " << numberOfOperations << " operations." << std::endl;
+					return 1;
+				}
+				std::this_thread::sleep_for(connectRetryInterval);
+				continue;
+			}
+			connectFailures = 0;
+			auto serpID = requestFromServer(*endpoint, "serpID");
+			auto parsedSerpID = serpID.has_value() ? SnackerEngine::from_string<SnackerEngine::SERPID>(serpID.value()) : std::nullopt;
+			if (parsedSerpID.has_value()) connections.push_back(SoakConnection{ std::move(endpoint), parsedSerpID.value() });
+		}
+		else if (operation < 25) {
+			// Disconnect, sometimes with messages still on their way
+			std::size_t index = random() % connections.size();
+			if (random() % 2 == 0) {
+				SnackerEngine::SERPRequest request(SnackerEngine::RequestStatusCode::GET, "ping");
+				connections[index].endpoint->finalizeAndSendMessage(request, false);
+				connections[index].endpoint->updateSend();
+			}
+			closeConnection(index);
+		}
+		else if (operation < 30) {
+			// Malformed message. The server should drop the connection.
+			std::size_t index = random() % connections.size();
+			std::vector<std::byte> garbage(1 + random() % 256);
+			for (auto& byte : garbage) byte = static_cast<std::byte>(random());
+			send(connections[index].endpoint->getTCPEndpoint().getSocket().sock, garbage.data(), garbage.size(), MSG_NOSIGNAL);
+			closeConnection(index);
+		}
+		else if (operation < 60) {
+			// Multicast to connected and vanished clients
+			SoakConnection& connection = connections[random() % connections.size()];
+			SnackerEngine::SERPRequest request(SnackerEngine::RequestStatusCode::POST, "soak", SnackerEngine::Buffer(std::string(random() % 4096, 'x')));
+			request.getHeader().source = connection.serpID;
+			request.getHeader().setMultiSendFlag(true);
+			for (unsigned i = 0, count = 1 + random() % 8; i < count; ++i) request.addDestination(static_cast<uint16_t>(static_cast<unsigned>(randomSerpID())));
+			connection.endpoint->finalizeAndSendMessage(request, false);
+			while (connection.endpoint->hasUnsentMessages()) connection.endpoint->updateSend();
+		}
+		else {
+			// Single request to a connected or vanished client
+			SoakConnection& connection = connections[random() % connections.size()];
+			SnackerEngine::SERPRequest request(SnackerEngine::RequestStatusCode::GET, "soak");
+			request.getHeader().source = connection.serpID;
+			request.getHeader().destination = randomSerpID();
+			connection.endpoint->finalizeAndSendMessage(request, false);
+			while (connection.endpoint->hasUnsentMessages()) connection.endpoint->updateSend();
+		}
+		numberOfOperations++;
+		drainConnections(connections);
+		if (std::chrono::steady_clock::now() >= nextSampleTime) {
+			auto currentSample = sample();
+			if (!currentSample.has_value()) {
+				std::cout << "[ERROR]: The server " << (isServerRunning(pid) ? "stopped answering" : "exited") << " after " << numberOfOperations << " operations." << std::endl;
+				return 1;
+			}
+			samples.push_back(currentSample.value());
+			std::cout << "[INFO]: t=" << static_cast<int>(currentSample->time) << "s rss=" << currentSample->residentBytes / 1024 << "kB threads=" << currentSample->threads
+				<< " liveClients=" << currentSample->liveClients << " disconnectedClients=" << currentSample->disconnectedClients << " connections=" << connections.size() << std::endl;
+			nextSampleTime += std::chrono::seconds(5);
+		}
+	}
+	// Close everything and give the server time to reap the clients
+	connections.clear();
+	std::this_thread::sleep_for(std::chrono::seconds(10));
+	auto finalSample = sample();
+	if (!finalSample.has_value()) {
+		std::cout << "[ERROR]: The server stopped answering." << std::endl;
+		return 1;
+	}
+	bool failed = false;
+	// Only the monitor connection may be left
+	if (finalSample->liveClients > baseline->liveClients) {
+		std::cout << "[ERROR]: " << finalSample->liveClients - baseline->liveClients << " client objects were not released." << std::endl;
+		failed = true;
+	}
+	if (finalSample->threads > baseline->threads) {
+		std::cout << "[ERROR]: The server has " << finalSample->threads - baseline->threads << " more threads than before the test." << std::endl;
+		failed = true;
+	}
+	// Compare the lowest RSS of the first and the last third of the test. Allocators keep freed memory, but
+	// the minimum should not keep rising.
+	if (samples.size() >= 6) {
+		std::size_t third = samples.size() / 3;
+		uint64_t early = getMinimumResidentBytes(samples.begin(), samples.begin() + static_cast<std::ptrdiff_t>(third));
+		uint64_t late = getMinimumResidentBytes(samples.end() - static_cast<std::ptrdiff_t>(third), samples.end());
+		if (late > early + residentTolerance * 1024 * 1024) {
+			std::cout << "[ERROR]: The resident set size grew from " << early / 1024 << " kB to " << late / 1024 << " kB." << std::endl;
+			failed = true;
+		}
+	}
+	std::cout << "[INFO]: " << numberOfOperations << " operations, final rss=" << finalSample->residentBytes / 1024 << "kB threads=" << finalSample->threads
+		<< " liveClients=" << finalSample->liveClients << (failed ? ". FAILED" : ". PASSED") << std::endl;
+	return failed ? 1 : 0;
+}
+
+/// Starts the server and runs random connects, disconnects, malformed messages and relays against it. Fails
+/// if the server dies or stops answering, or if it keeps client objects, threads or memory afterwards.
+int main(int argc, char** argv)
+{
+	if (argc < 2) {
+		std::cout << "usage: soakSERPServer <path to SERPServer> [--seconds <duration>] [--clients <max connections>] [--seed <seed>] [--rssTolerance <MiB>]" << std::endl;
+		return -1;
+	}
+	std::string executable = argv[1];
+	unsigned seconds = 600;
+	std::size_t maxClients = 64;
+	unsigned seed = std::random_device{}();
+	uint64_t residentTolerance = 32;
+	for (int i = 2; i < argc; ++i) {
+		std::string argument = argv[i];
+		std::optional<unsigned> value = i + 1 < argc ? SnackerEngine::from_string<unsigned>(argv[i + 1]) : std::nullopt;
+		if (!value.has_value()) {
+			std::cout << "[ERROR]: Invalid command line argument \"" << argument << "\"." << std::endl;
+			return -1;
+		}
+		if (argument == "--seconds") seconds = std::max(value.value(), 10u);
+		else if (argument == "--clients") maxClients = std::max(value.value(), 1u);
+		else if (argument == "--seed") seed = value.value();
+		else if (argument == "--rssTolerance") residentTolerance = value.value();
+		else {
+			std::cout << "[ERROR]: Invalid command line argument \"" << argument << "\"." << std::endl;
+			return -1;
+		}
+		++i;
+	}
+	SnackerEngine::initializeNetwork();
+	uint16_t port = SnackerEngine::getSERPServerPort();
+	// Make sure we don't soak a server that is already running
+	if (auto endpoint = connectToServer(port)) {
+		std::cout << "[ERROR]: Another server is already listening on port " << port << "." << std::endl;
+		return -1;
+	}
+	pid_t pid = startServer(executable);
+	if (pid == -1) {
+		std::cout << "[ERROR]: Could not start \"" << executable << "\"." << std::endl;
+		return -1;
+	}
+	int result = soak(pid, port, seconds, maxClients, seed, residentTolerance);
+	stopServer(pid);
+	return result;
+}
@@ -0,0 +1,161 @@
+#include "SocketTuning.h"
+
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+/// Number of round trips in the latency benchmark
+static constexpr int numberOfRoundTrips = 200;
+/// Size of a message in the latency benchmark. Messages are written in two parts (header and body),
+/// like the endpoint does when a message does not fit into one send.
+static constexpr std::size_t latencyHeaderSize = 16;
+static constexpr std::size_t latencyBodySize = 112;
+/// Number and size of messages in the throughput benchmark, and the number of messages per batch
+static constexpr std::size_t numberOfSmallMessages = 1 << 20;
+static constexpr std::size_t smallMessageSize = 128;
+static constexpr std::size_t batchSize = 64;
+
+/// A connected pair of TCP sockets on the loopback interface. Both sockets are closed when the pair is
+/// destroyed, st. long sweeps over many profiles don't run out of file descriptors.
+struct LoopbackPair
+{
+	SnackerEngine::SocketTCP client;
+	SnackerEngine::SocketTCP server;
+	/// Constructor, the sockets are created by createLoopbackPair()
+	LoopbackPair() { client.sock = -1; server.sock = -1; }
+	/// Destructor, closes both sockets
+	~LoopbackPair()
+	{
+		if (client.sock != -1) close(client.sock);
+		if (server.sock != -1) close(server.sock);
+	}
+	/// Deleted Copy and move constructors and assignment operators
+	LoopbackPair(LoopbackPair& other) = delete;
+	LoopbackPair(LoopbackPair&& other) = delete;
+	LoopbackPair& operator=(LoopbackPair& other) = delete;
+	LoopbackPair& operator=(LoopbackPair&& other) = delete;
+};
+
+/// Connects the sockets of the given pair. The listening socket is only needed until the connection was accepted.
+static bool createLoopbackPair(LoopbackPair& pair)
+{
+	int listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (listener == -1) return false;
+	pair.client.sock = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t addressLength = sizeof(address);
+	bool success = pair.client.sock != -1 &&
+		bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0 &&
+		listen(listener, 1) == 0 &&
+		getsockname(listener, reinterpret_cast<sockaddr*>(&address), &addressLength) == 0 &&
+		connect(pair.client.sock, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+	if (success) pair.server.sock = accept(listener, nullptr, nullptr);
+	close(listener);
+	return success && pair.server.sock != -1;
+}
+
+/// Helper functions that write/read exactly size bytes (blocking)
+static bool writeAll(int socket, const std::byte* data, std::size_t size)
+{
+	while (size > 0) {
+		ssize_t result = send(socket, data, size, MSG_NOSIGNAL);
+		if (result <= 0) return false;
+		data += result;
+		size -= static_cast<std::size_t>(result);
+	}
+	return true;
+}
+
+static bool readAll(int socket, std::byte* data, std::size_t size)
+{
+	while (size > 0) {
+		ssize_t result = recv(socket, data, size, 0);
+		if (result <= 0) return false;
+		data += result;
+		size -= static_cast<std::size_t>(result);
+	}
+	return true;
+}
+
+/// Measures the mean round trip time in microseconds of request/response pairs that are written in two parts
+static double measureLatency(const SocketProfile& profile)
+{
+	LoopbackPair pair;
+	if (!createLoopbackPair(pair)) return -1.0;
+	SnackerEngine::SocketTCP& client = pair.client;
+	SnackerEngine::SocketTCP& server = pair.server;
+	applySocketProfile(client, profile, false);
+	applySocketProfile(server, profile, false);
+	std::thread echoThread([&server]() {
+		std::vector<std::byte> message(latencyHeaderSize + latencyBodySize);
+		for (int i = 0; i < numberOfRoundTrips; ++i) {
+			if (!readAll(server.sock, message.data(), message.size())) return;
+			if (!writeAll(server.sock, message.data(), latencyHeaderSize)) return;
+			if (!writeAll(server.sock, message.data() + latencyHeaderSize, latencyBodySize)) return;
+		}
+	});
+	std::vector<std::byte> message(latencyHeaderSize + latencyBodySize);
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < numberOfRoundTrips; ++i) {
+		if (!writeAll(client.sock, message.data(), latencyHeaderSize)) break;
+		if (!writeAll(client.sock, message.data() + latencyHeaderSize, latencyBodySize)) break;
+		if (!readAll(client.sock, message.data(), message.size())) break;
+	}
+	auto duration = std::chrono::steady_clock::now() - start;
+	echoThread.join();
+	return std::chrono::duration<double, std::micro>(duration).count() / numberOfRoundTrips;
+}
+
+/// Measures the throughput in MB/s of many small messages, written in batches like the sender thread does
+static double measureThroughput(const SocketProfile& profile)
+{
+	LoopbackPair pair;
+	if (!createLoopbackPair(pair)) return -1.0;
+	SnackerEngine::SocketTCP& client = pair.client;
+	SnackerEngine::SocketTCP& server = pair.server;
+	applySocketProfile(client, profile, false);
+	applySocketProfile(server, profile, false);
+	std::thread drainThread([&server]() {
+		std::vector<std::byte> buffer(1 << 16);
+		std::size_t remaining = numberOfSmallMessages * smallMessageSize;
+		while (remaining > 0) {
+			ssize_t result = recv(server.sock, buffer.data(), std::min(buffer.size(), remaining), 0);
+			if (result <= 0) return;
+			remaining -= static_cast<std::size_t>(result);
+		}
+	});
+	std::vector<std::byte> message(smallMessageSize);
+	auto start = std::chrono::steady_clock::now();
+	for (std::size_t i = 0; i < numberOfSmallMessages; i += batchSize) {
+		if (profile.corkBatches) setSocketCork(client, true);
+		for (std::size_t j = 0; j < batchSize; ++j) writeAll(client.sock, message.data(), message.size());
+		if (profile.corkBatches) setSocketCork(client, false);
+	}
+	drainThread.join();
+	auto duration = std::chrono::steady_clock::now() - start;
+	return static_cast<double>(numberOfSmallMessages * smallMessageSize) / (1024.0 * 1024.0) / std::chrono::duration<double>(duration).count();
+}
+
+/// Compares the socket profiles of the server on the loopback interface: round trip time of small messages
+/// that are written in two parts (which triggers Nagle's algorithm) and throughput of batches of small messages.
+int main(int argc, char** argv)
+{
+	std::vector<std::string> profiles = { "system", "interactive", "bulk" };
+	if (argc > 1) profiles.assign(argv + 1, argv + argc);
+	std::cout << "profile\tround trip us\tbatched MB/s" << std::endl;
+	for (const std::string& name : profiles) {
+		auto profile = getSocketProfile(name);
+		if (!profile.has_value()) {
+			std::cout << "[ERROR]: Unknown socket profile \"" << name << "\"." << std::endl;
+			return -1;
+		}
+		std::cout << name << "\t" << measureLatency(profile.value()) << "\t" << measureThroughput(profile.value()) << std::endl;
+	}
+	return 0;
+}
@@ -7,7 +7,7 @@
 #include <sys/stat.h>
 #include <fstream>
 
-int main()
+int main(int argc, char** argv)
 {
     // Before we create the daemon, check if there is already a server running!
     // First read the pid
@@ -69,6 +69,7 @@ int main()
 	try {
 		SnackerEngine::initializeNetwork();
 		Server server;
+		if (!server.parseCommandLineArguments(argc, argv)) return -1;
 		server.run();
 	}
 	catch (std::exception& e) {
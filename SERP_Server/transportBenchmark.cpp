@@ -0,0 +1,195 @@
+#include "SharedMemoryChannel.h"
+#include "Utility/Formatting.h"
+
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/un.h>
+
+/// Number of round trips in the latency benchmark
+static constexpr int numberOfRoundTrips = 10000;
+/// Number of messages in the throughput benchmark
+static constexpr std::size_t numberOfMessages = 200000;
+/// Capacity of each ring of the shared memory segment (the server default)
+static constexpr uint64_t ringCapacity = 1 << 20;
+/// Time in ms the shared memory transport waits for data/free space
+static constexpr int sharedMemoryTimeout = 1000;
+
+/// Creates a connected pair of TCP sockets on the loopback interface
+static bool createLoopbackPair(int& client, int& server)
+{
+	int listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	client = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	server = -1;
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t addressLength = sizeof(address);
+	bool success = listener != -1 && client != -1 &&
+		bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0 &&
+		listen(listener, 1) == 0 &&
+		getsockname(listener, reinterpret_cast<sockaddr*>(&address), &addressLength) == 0 &&
+		connect(client, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0 &&
+		(server = accept(listener, nullptr, nullptr)) != -1;
+	if (listener != -1) close(listener);
+	if (!success) return false;
+	// Like the interactive socket profile, st. small messages are not delayed
+	int enable = 1;
+	setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+	setsockopt(server, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+	return true;
+}
+
+/// Creates a connected pair of AF_UNIX stream sockets, like a client on the local socket of the server
+static bool createLocalPair(int& client, int& server)
+{
+	int sockets[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) == -1) return false;
+	client = sockets[0];
+	server = sockets[1];
+	return true;
+}
+
+/// Helper functions that write/read exactly size bytes (blocking)
+static bool writeAll(int socket, const std::byte* data, std::size_t size)
+{
+	while (size > 0) {
+		ssize_t result = send(socket, data, size, MSG_NOSIGNAL);
+		if (result <= 0) return false;
+		data += result;
+		size -= static_cast<std::size_t>(result);
+	}
+	return true;
+}
+
+static bool readAll(int socket, std::byte* data, std::size_t size)
+{
+	while (size > 0) {
+		ssize_t result = recv(socket, data, size, 0);
+		if (result <= 0) return false;
+		data += result;
+		size -= static_cast<std::size_t>(result);
+	}
+	return true;
+}
+
+/// One side of a connection. Sockets transport the serialized message and parse it after reading it,
+/// st. all transports include the same parsing work.
+struct Transport
+{
+	int socket = -1;
+	std::unique_ptr<SharedMemoryChannel> channel;
+	bool send(const SnackerEngine::Buffer& serialized)
+	{
+		if (channel) return channel->sendSerializedMessage(serialized, sharedMemoryTimeout);
+		return writeAll(socket, serialized.data(), serialized.size());
+	}
+	/// Receives the given number of messages of the given serialized size
+	bool receive(std::size_t count, std::size_t size)
+	{
+		if (channel) {
+			bool doorbell = false;
+			while (count > 0) {
+				auto messages = channel->receiveMessages(sharedMemoryTimeout, doorbell);
+				if (!messages.has_value() || messages.value().empty()) return false;
+				count -= std::min(count, messages.value().size());
+			}
+			return true;
+		}
+		SnackerEngine::Buffer buffer(size);
+		for (; count > 0; --count) {
+			if (!readAll(socket, buffer.data(), size) || !SnackerEngine::SERPMessage::parse(buffer.getBufferView())) return false;
+		}
+		return true;
+	}
+	~Transport()
+	{
+		if (socket != -1) close(socket);
+	}
+};
+
+/// Creates both sides of the given transport ("tcp", "local" or "shm")
+static bool createTransports(const std::string& name, Transport& client, Transport& server)
+{
+	if (name == "tcp") return createLoopbackPair(client.socket, server.socket);
+	if (name == "local") return createLocalPair(client.socket, server.socket);
+	if (name == "shm") {
+		server.channel = SharedMemoryChannel::create(ringCapacity, geteuid());
+		if (!server.channel) return false;
+		client.channel = SharedMemoryChannel::attach(server.channel->getName());
+		return client.channel != nullptr;
+	}
+	return false;
+}
+
+/// Measures the mean round trip time in microseconds of request/response pairs with the given body size
+static double measureLatency(const std::string& name, std::size_t bodySize)
+{
+	Transport client, server;
+	if (!createTransports(name, client, server)) return -1.0;
+	SnackerEngine::SERPRequest request(SnackerEngine::RequestStatusCode::GET, "benchmark", SnackerEngine::Buffer(std::string(bodySize, 'x')));
+	SnackerEngine::Buffer serialized = request.serialize();
+	std::thread echoThread([&]() {
+		for (int i = 0; i < numberOfRoundTrips; ++i) {
+			if (!server.receive(1, serialized.size()) || !server.send(serialized)) return;
+		}
+	});
+	int completedRoundTrips = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (; completedRoundTrips < numberOfRoundTrips; ++completedRoundTrips) {
+		if (!client.send(serialized) || !client.receive(1, serialized.size())) break;
+	}
+	auto duration = std::chrono::steady_clock::now() - start;
+	echoThread.join();
+	if (completedRoundTrips < numberOfRoundTrips) return -1.0;
+	return std::chrono::duration<double, std::micro>(duration).count() / numberOfRoundTrips;
+}
+
+/// Measures the throughput in MB/s of a stream of messages with the given body size
+static double measureThroughput(const std::string& name, std::size_t bodySize)
+{
+	Transport client, server;
+	if (!createTransports(name, client, server)) return -1.0;
+	SnackerEngine::SERPRequest request(SnackerEngine::RequestStatusCode::POST, "benchmark", SnackerEngine::Buffer(std::string(bodySize, 'x')));
+	SnackerEngine::Buffer serialized = request.serialize();
+	bool received = false;
+	std::thread drainThread([&]() { received = server.receive(numberOfMessages, serialized.size()); });
+	auto start = std::chrono::steady_clock::now();
+	for (std::size_t i = 0; i < numberOfMessages; ++i) {
+		if (!client.send(serialized)) break;
+	}
+	drainThread.join();
+	auto duration = std::chrono::steady_clock::now() - start;
+	if (!received) return -1.0;
+	return static_cast<double>(numberOfMessages * serialized.size()) / (1024.0 * 1024.0) / std::chrono::duration<double>(duration).count();
+}
+
+/// Compares the transports a client on the same host can use: TCP over the loopback interface, the local
+/// AF_UNIX socket and the shared memory ring. Reports the round trip time and the throughput of SERP
+/// messages with the given body sizes. A result of -1 means the transport could not be set up.
+int main(int argc, char** argv)
+{
+	std::vector<std::size_t> bodySizes = { 64, 1024, 16384 };
+	if (argc > 1) {
+		bodySizes.clear();
+		for (int i = 1; i < argc; ++i) {
+			auto bodySize = SnackerEngine::from_string<unsigned>(argv[i]);
+			if (!bodySize.has_value() || bodySize.value() > ringCapacity / 2) {
+				std::cout << "[ERROR]: Invalid body size \"" << argv[i] << "\" (at most " << ringCapacity / 2 << " bytes)." << std::endl;
+				return -1;
+			}
+			bodySizes.push_back(bodySize.value());
+		}
+	}
+	std::cout << "transport\tbody bytes\tround trip us\tMB/s" << std::endl;
+	for (std::size_t bodySize : bodySizes) {
+		for (const std::string name : { "tcp", "local", "shm" }) {
+			std::cout << name << "\t" << bodySize << "\t" << measureLatency(name, bodySize) << "\t" << measureThroughput(name, bodySize) << std::endl;
+		}
+	}
+	return 0;
+}
@@ -15,6 +15,8 @@ class TextureDemo : public SnackerEngine::Scene
 {
 	SnackerEngine::FPSCamera camera;
 	SnackerEngine::Model sphere;
+	// The small sphere covers only a few pixels, a coarse mesh looks the same there
+	SnackerEngine::Model smallSphere;
 	SnackerEngine::Model cube;
 	SnackerEngine::Material simpleMaterial;
 
@@ -26,21 +28,35 @@ class TextureDemo : public SnackerEngine::Scene
 	float smallSphereScale;
 
 	SnackerEngine::Texture earthTexture;
-	SnackerEngine::Texture containerTexture;
+	SnackerEngine::Texture cubeTexture;
 	SnackerEngine::Texture dabbingPenguinTexture;
 
 public:
 
+	/// Loads the texture of the cube: the mona lisa through Load2DFromRawData. container.jpg is only
+	/// loaded as a fallback if the mona lisa is missing.
+	static SnackerEngine::Texture loadCubeTexture()
+	{
+		std::optional<std::string> fullPath = SnackerEngine::Engine::getFullPath("textures/mona_lisa.jpg");
+		if (fullPath.has_value()) {
+			std::optional<SnackerEngine::Buffer> rawDataBuffer = SnackerEngine::Buffer::loadFromFile(fullPath.value());
+			if (rawDataBuffer.has_value()) {
+				return SnackerEngine::Texture::Load2DFromRawData(rawDataBuffer.value().getBufferView(), fullPath.value()).first;
+			}
+		}
+		return SnackerEngine::Texture::Load2D("textures/container.jpg").first;
+	}
+
 	void computePositionSmallSphere()
 	{
 		positionSmallSphere = { -3.0f + 1.5f * sin(angle), 0.0f + 1.5f * cos(angle), 10.0f };
 	}
 
 	TextureDemo()
-		: camera{}, sphere(SnackerEngine::createMeshUVSphere(100, 100)), cube(SnackerEngine::createMeshCube(true, true, false)),
+		: camera{}, sphere(SnackerEngine::createMeshUVSphere(100, 100)), smallSphere(SnackerEngine::createMeshUVSphere(20, 20)), cube(SnackerEngine::createMeshCube(true, true, false)),
 		simpleMaterial(SnackerEngine::Shader("shaders/basicTexture.shader")), positionSphere({ -3.0f, 0.0f, 10.0f }), positionCube({ 3.0f, 0.0f, 10.0f }),
 		positionSmallSphere(0.0f, 0.0f, 0.0f), angle(0.0f), rotationSpeed(0.7f), smallSphereScale(0.2f),
-		earthTexture(SnackerEngine::Texture::Load2D("textures/earthmap1k.jpg").first), containerTexture(SnackerEngine::Texture::Load2D("textures/container.jpg").first),
+		earthTexture(SnackerEngine::Texture::Load2D("textures/earthmap1k.jpg").first), cubeTexture(loadCubeTexture()),
 		dabbingPenguinTexture(SnackerEngine::Texture::Load2D("textures/dab_penguin.jpg").first)
 	{
 		SnackerEngine::Renderer::setClearColor(SnackerEngine::Color3f::fromColor256(SnackerEngine::Color3<unsigned>(186, 214, 229)));
@@ -48,15 +64,6 @@ public:
 		camera.setFarPlane(1000.0f);
 		simpleMaterial.getShader().bind();
 		simpleMaterial.getShader().setUniform<int>("u_Texture", 0);
-
-		// DEBUG
-		std::optional<std::string> fullPath = SnackerEngine::Engine::getFullPath("textures/mona_lisa.jpg");
-		if (fullPath.has_value()) {
-			std::optional<SnackerEngine::Buffer> rawDataBuffer = SnackerEngine::Buffer::loadFromFile(fullPath.value());
-			if (rawDataBuffer.has_value()) {
-				containerTexture = SnackerEngine::Texture::Load2DFromRawData(rawDataBuffer.value().getBufferView(), fullPath.value()).first;
-			}
-		}
 	}
 
 	void update(const double& dt) override
@@ -76,9 +83,9 @@ public:
 		computePositionSmallSphere();
 		simpleMaterial.getShader().setModelViewProjection(SnackerEngine::Mat4f::TranslateAndScale(positionSmallSphere, SnackerEngine::Vec3f(smallSphereScale)), camera.getViewMatrix(), camera.getProjectionMatrix());
 		dabbingPenguinTexture.bind();
-		SnackerEngine::Renderer::draw(sphere, simpleMaterial);
+		SnackerEngine::Renderer::draw(smallSphere, simpleMaterial);
 		simpleMaterial.getShader().setModelViewProjection(SnackerEngine::Mat4f::Translate(positionCube), camera.getViewMatrix(), camera.getProjectionMatrix());
-		containerTexture.bind();
+		cubeTexture.bind();
 		SnackerEngine::Renderer::draw(cube, simpleMaterial);
 	}
 